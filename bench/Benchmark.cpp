@@ -0,0 +1,360 @@
+#include "Game.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times the ECS and the simulation systems on synthetic scenes of a given size
+// and reports nanoseconds per entity as JSON. Scenes are built from a fixed seed
+// and their play area grows with the entity count, so density stays the same
+// as a 1000 entity scene in a 1920x1080 window and results compare across sizes.
+//
+// Lifespans in bench_config.txt are the game's own. A scene's bullets look as
+// if they spawned over the last lifespan, so some expire on every frame. Only
+// sLifespan moves time on, and it runs on a scene of its own that is topped
+// back up between runs, so the other systems always see the full count.
+class Benchmark
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Result
+    {
+        std::string     name;
+        size_t          entities    = 0;
+        size_t          iterations  = 0;
+        double          nsPerEntity = 0.0;
+    };
+
+    std::string             m_config;
+    unsigned                m_seed      = 1;
+    double                  m_minTime   = 0.25;     // seconds spent measuring each benchmark
+    std::vector<Result>     m_results;
+
+    // a headless game holding n entities, 10% enemies and 90% bullets spread over the play area
+    std::unique_ptr<Game> makeScene(size_t n)
+    {
+        GameOptions options;
+        options.config = m_config;
+        options.seed = m_seed;
+        options.headless = true;
+
+        auto game = std::make_unique<Game>(options);
+        Game& g = *game;
+
+        float scale = std::sqrt(std::max(1.0f, n / 1000.0f));
+        g.m_windowSize = sf::Vector2u((unsigned)(1920 * scale), (unsigned)(1080 * scale));
+        g.m_xDist = std::uniform_real_distribution<float>(g.m_enemyConfig.SR, g.m_windowSize.x - g.m_enemyConfig.SR);
+        g.m_yDist = std::uniform_real_distribution<float>(g.m_enemyConfig.SR, g.m_windowSize.y - g.m_enemyConfig.SR);
+
+        for (size_t i = 0; i < n / 10; i++)
+        {
+            g.spawnEnemy();
+        }
+        for (size_t i = n / 10; i < n; i++)
+        {
+            addBullet(g);
+        }
+        g.m_entities.update();
+
+        // spawned anywhere in the last lifespan, so expiries are spread over the frames to come
+        for (auto& b : g.m_entities.getEntities(Tag::Bullet))
+        {
+            auto& lifespan = b.get<CLifespan>();
+            lifespan.spawnFrame = g.m_currentFrame - (int)(g.m_randomGen() % (unsigned)lifespan.lifespan);
+        }
+        g.scheduleLifespans();
+        return game;
+    }
+
+    // spawns a bullet at a random point flying in a random direction
+    static void addBullet(Game& g)
+    {
+        Vec2f pos(g.m_xDist(g.m_randomGen), g.m_yDist(g.m_randomGen));
+        Vec2f target(g.m_xDist(g.m_randomGen), g.m_yDist(g.m_randomGen));
+        g.player().get<CTransform>().pos = pos;
+        g.spawnBullet(g.player(), target);
+    }
+
+    // runs body until m_minTime has passed and returns the median ns per entity,
+    // setup runs untimed before every iteration
+    template <typename Setup, typename Body>
+    Result measure(const std::string& name, size_t entities, Setup&& setup, Body&& body)
+    {
+        std::vector<double> samples;
+        double total = 0.0;
+
+        // one untimed warm up run
+        setup();
+        body();
+
+        while ((total < m_minTime || samples.size() < 5) && samples.size() < 10000)
+        {
+            setup();
+            auto start = Clock::now();
+            body();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            samples.push_back(seconds);
+            total += seconds;
+        }
+
+        std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+        Result r;
+        r.name = name;
+        r.entities = entities;
+        r.iterations = samples.size();
+        r.nsPerEntity = samples[samples.size() / 2] * 1e9 / entities;
+
+        std::cerr << name << " @ " << entities << ": " << r.nsPerEntity << " ns/entity ("
+                  << r.iterations << " iterations)\n";
+        return r;
+    }
+
+public:
+
+    Benchmark(const std::string& config, unsigned seed, double minTime)
+        : m_config(config)
+        , m_seed(seed)
+        , m_minTime(minTime)
+    {}
+
+    void run(size_t n)
+    {
+        auto noSetup = [] {};
+
+        // addEntity / update churn: spawn n bullets, then destroy them all
+        {
+            auto scene = makeScene(0);
+            Game& g = *scene;
+            m_results.push_back(measure("addEntity+update", n, noSetup, [&]
+            {
+                for (size_t i = 0; i < n; i++) { addBullet(g); }
+                g.m_entities.update();
+                for (auto& b : g.m_entities.getEntities(Tag::Bullet)) { b.destroy(); }
+                g.m_entities.update();
+            }));
+        }
+
+        auto scene = makeScene(n);
+        Game& g = *scene;
+        size_t count = g.m_entities.getEntities().size();
+
+        // a handful of deaths and births among many long-lived entities, update should only pay for those
+        m_results.push_back(measure("update(10 churn)", count, noSetup, [&]
+        {
+            const auto& bullets = g.m_entities.getEntities(Tag::Bullet);
+            for (size_t i = 0; i < 10 && i < bullets.size(); i++) { bullets[i].destroy(); }
+            for (size_t i = 0; i < 10; i++) { addBullet(g); }
+            g.m_entities.update();
+        }));
+
+        // per-entity tag checks like the ones the systems make
+        size_t bullets = 0;
+        m_results.push_back(measure("tagLookup", count, noSetup, [&]
+        {
+            for (size_t id = 0; id < g.m_entities.size(); id++)
+            {
+                bullets += g.m_entities.isActive(id) && g.m_entities.tag(id) == Tag::Bullet;
+            }
+            bullets += g.m_entities.getEntities(Tag::Bullet).size();
+        }));
+
+        // the entities with a lifespan, through a view and by asking every entity
+        size_t fading = 0;
+        m_results.push_back(measure("view<CTransform,CLifespan>", count, noSetup, [&]
+        {
+            for (auto [e, transform, lifespan] : g.m_entities.view<CTransform, CLifespan>())
+            {
+                fading += transform.pos.x >= 0.0f && lifespan.lifespan > 0;
+            }
+        }));
+        m_results.push_back(measure("getEntities+has<CLifespan>", count, noSetup, [&]
+        {
+            for (auto& e : g.m_entities.getEntities())
+            {
+                if (!e.has<CLifespan>()) { continue; }
+                fading += e.get<CTransform>().pos.x >= 0.0f && e.get<CLifespan>().lifespan > 0;
+            }
+        }));
+
+        // the proximity index allies aim with: a full rebuild, a new frame each run, then per lookup
+        int indexFrame = g.m_currentFrame;
+        m_results.push_back(measure("SpatialIndex::refresh", count, noSetup, [&]
+        {
+            g.m_enemyIndex.refresh(g.m_entities, ++indexFrame);
+        }));
+        size_t found = 0;
+        const size_t lookups = 1000;
+        m_results.push_back(measure("kNearest(1)", lookups, noSetup, [&]
+        {
+            for (size_t i = 0; i < lookups; i++)
+            {
+                Vec2f pos(g.m_xDist(g.m_randomGen), g.m_yDist(g.m_randomGen));
+                g.m_enemyIndex.kNearest(pos, 1, { Tag::Enemy, Tag::SmallEnemy }, g.m_nearestEnemies);
+                found += g.m_nearestEnemies.size();
+            }
+        }));
+        m_results.push_back(measure("queryRadius(100)", lookups, noSetup, [&]
+        {
+            for (size_t i = 0; i < lookups; i++)
+            {
+                Vec2f pos(g.m_xDist(g.m_randomGen), g.m_yDist(g.m_randomGen));
+                g.m_enemyIndex.queryRadius(pos, 100.0f, { Tag::Enemy }, [&](const Entity&) { found++; });
+            }
+        }));
+        m_results.push_back(measure("queryAABB(200x200)", lookups, noSetup, [&]
+        {
+            for (size_t i = 0; i < lookups; i++)
+            {
+                Vec2f pos(g.m_xDist(g.m_randomGen), g.m_yDist(g.m_randomGen));
+                g.m_enemyIndex.queryAABB(pos - Vec2f(100.0f, 100.0f), pos + Vec2f(100.0f, 100.0f), { Tag::Enemy },
+                    [&](const Entity&) { found++; });
+            }
+        }));
+
+        m_results.push_back(measure("sMovement", count, noSetup, [&] { g.sMovement(); }));
+
+        // one frame further each run, so this is the timer wheel's per-tick cost with
+        // about count / lifespan bullets expiring. What expired is replaced untimed
+        // before the next run, like the bullets a game keeps firing
+        {
+            auto lifespanScene = makeScene(n);
+            Game& l = *lifespanScene;
+            size_t expired = 0;
+            m_results.push_back(measure("sLifespan", count, [&]
+            {
+                l.m_entities.update();
+                size_t missing = count - l.m_entities.getEntities().size();
+                expired += missing;
+                for (size_t i = 0; i < missing; i++) { addBullet(l); }
+                l.m_entities.update();
+                l.scheduleLifespans();
+            }, [&] { l.m_currentFrame++; l.sLifespan(); }));
+            if (expired == 0) { std::cerr << "sLifespan expired nothing\n"; }
+        }
+        // the raw kernels behind sMovement and sCollision's wall bounce, once per instruction set
+        auto& transforms = g.m_entities.getComponents<CTransform>();
+        size_t slots = g.m_entities.size();
+        for (int isa = 0; isa <= (int)Kernels::best(); isa++)
+        {
+            Kernels::use((Kernels::Isa)isa);
+            std::string suffix = std::string("/") + Kernels::name((Kernels::Isa)isa);
+
+            m_results.push_back(measure("integrate" + suffix, count, noSetup, [&]
+            {
+                Kernels::integrate(transforms.positions().data(), transforms.velocities().data(),
+                    transforms.angles().data(), 0, slots, 1.0f);
+            }));
+            m_results.push_back(measure("bounce" + suffix, count, noSetup, [&]
+            {
+                Kernels::bounce(transforms.positions().data(), transforms.velocities().data(),
+                    g.m_entities.tags().data(), Tag::Enemy, (float)g.m_enemyConfig.CR,
+                    (float)g.m_windowSize.x, (float)g.m_windowSize.y, 0, slots);
+            }));
+        }
+        Kernels::use(Kernels::best());
+
+        m_results.push_back(measure("buildRenderBatch", count, noSetup, [&] { g.buildRenderBatch(0.5f); }));
+
+        // sCollision only records contacts, sCollisionResponse acts on them, so runs can
+        // repeat on one scene. It gets a fresh one: the runs above have moved everything
+        // far out of the window. Every entity is put one tick of movement back, so the
+        // bullets are swept along a real path like in a game
+        {
+            auto collisionScene = makeScene(n);
+            Game& c = *collisionScene;
+            auto& transforms = c.m_entities.getComponents<CTransform>();
+            for (size_t id = 0; id < c.m_entities.size(); id++)
+            {
+                transforms.prevPositions()[id] = transforms.positions()[id] - transforms.velocities()[id];
+            }
+            size_t contacts = 0;
+            m_results.push_back(measure("sCollision", count, noSetup, [&]
+            {
+                c.sCollision();
+                contacts += c.m_contacts.size();
+            }));
+            if (contacts == 0) { std::cerr << "sCollision found no contacts\n"; }
+        }
+
+        if (bullets == 0) { std::cerr << "tagLookup found no bullets\n"; }
+        if (fading == 0) { std::cerr << "view found no lifespans\n"; }
+        if (found == 0) { std::cerr << "kNearest found no enemies\n"; }
+    }
+
+    void writeJson(std::ostream& out) const
+    {
+        out << "{\n  \"seed\": " << m_seed << ",\n  \"benchmarks\": [";
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const Result& r = m_results[i];
+            out << (i ? ",\n" : "\n")
+                << "    { \"name\": \"" << r.name << "\", \"entities\": " << r.entities
+                << ", \"iterations\": " << r.iterations << ", \"ns_per_entity\": " << r.nsPerEntity << " }";
+        }
+        out << "\n  ]\n}\n";
+    }
+};
+
+void printUsage(const char* program)
+{
+    std::cerr << "usage: " << program << " [options]\n"
+              << "  --config <path>     config file (default bench/bench_config.txt)\n"
+              << "  --sizes <a,b,...>   entity counts to run (default 1000,10000,100000)\n"
+              << "  --seed <n>          RNG seed for the scenes (default 1)\n"
+              << "  --min-time <s>      seconds to measure each benchmark (default 0.25)\n"
+              << "  --out <path>        write the JSON results to a file instead of stdout\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::string config = "bench/bench_config.txt";
+    std::string outPath;
+    std::vector<size_t> sizes = { 1000, 10000, 100000 };
+    unsigned seed = 1;
+    double minTime = 0.25;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--config" && hasValue) { config = argv[++i]; }
+        else if (arg == "--seed" && hasValue) { seed = (unsigned)std::stoul(argv[++i]); }
+        else if (arg == "--min-time" && hasValue) { minTime = std::stod(argv[++i]); }
+        else if (arg == "--out" && hasValue) { outPath = argv[++i]; }
+        else if (arg == "--sizes" && hasValue)
+        {
+            sizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string size;
+            while (std::getline(list, size, ',')) { sizes.push_back(std::stoul(size)); }
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    Benchmark bench(config, seed, minTime);
+    for (size_t n : sizes)
+    {
+        bench.run(n);
+    }
+
+    if (outPath.empty())
+    {
+        bench.writeJson(std::cout);
+    }
+    else
+    {
+        std::ofstream out(outPath);
+        bench.writeJson(out);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Vec2.hpp"
+#include "Vec2Array.hpp"
+#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <vector>
+
+// Collects the polygons of every entity into one triangle list so the whole
+// scene goes to the GPU in a single draw call instead of one per shape. The
+// corners are generated here from a unit polygon cached per point count, so
+// entities only store a radius, a point count and colours
+class BatchRenderer
+{
+    std::vector<sf::Vertex>             m_vertices;
+    std::vector<Vec2fArray>             m_unitPolygons;     // unit circle points, indexed by point count
+    std::vector<float>                  m_outlineScales;    // 1 / cos(pi / n), how far out an outline corner is per unit of thickness
+    Vec2fArray                          m_directions;       // unit polygon turned to the current shape's angle
+    Vec2fArray                          m_inner;            // corners of the current shape
+    Vec2fArray                          m_outer;            // corners of its outline
+
+    // points of a regular polygon with radius 1, laid out the same way sf::CircleShape does
+    const Vec2fArray& unitPolygon(size_t points)
+    {
+        if (points >= m_unitPolygons.size())
+        {
+            m_unitPolygons.resize(points + 1);
+            m_outlineScales.resize(points + 1);
+        }
+
+        auto& polygon = m_unitPolygons[points];
+        if (polygon.empty())
+        {
+            for (size_t i = 0; i < points; i++)
+            {
+                polygon.push_back(Vec2f::polar(i * 2.0f * 3.141592f / points - 3.141592f / 2.0f));
+            }
+            m_outlineScales[points] = 1.0f / std::cos(3.141592f / points);
+        }
+        return polygon;
+    }
+
+public:
+
+    BatchRenderer() = default;
+
+    void clear()
+    {
+        m_vertices.clear();
+    }
+
+    size_t vertexCount() const
+    {
+        return m_vertices.size();
+    }
+
+    // appends a filled polygon and its outline, angle is in degrees like sf::Transformable
+    void addPolygon(const Vec2f& pos, float angle, float radius, size_t points,
+        const sf::Color& fill, const sf::Color& outline, float outlineThickness)
+    {
+        if (points < 3) { return; }
+
+        bool outlined = outlineThickness != 0.0f;
+
+        // every corner is computed once, in batches over the whole polygon, and
+        // shared by the triangles on both sides of it
+        m_directions = unitPolygon(points);
+        m_directions.rotateAll(angle * 3.141592f / 180.0f);
+        m_inner.resize(points);
+        m_inner.fill(pos);
+        m_inner.addScaled(m_directions, radius);
+        if (outlined)
+        {
+            // offsetting each edge by the thickness moves the corners out by thickness / cos(pi / n)
+            m_outer.resize(points);
+            m_outer.fill(pos);
+            m_outer.addScaled(m_directions, radius + outlineThickness * m_outlineScales[points]);
+        }
+
+        // the fill's triangles then the outline's quads, written straight into the vertex array
+        size_t fillStart = m_vertices.size();
+        size_t outlineStart = fillStart + points * 3;
+        m_vertices.resize(outlineStart + (outlined ? points * 6 : 0));
+
+        sf::Vector2f center(pos.x, pos.y);
+        for (size_t i = 0; i < points; i++)
+        {
+            size_t next = i + 1 < points ? i + 1 : 0;
+            Vec2f inner0 = m_inner[i], inner1 = m_inner[next];
+
+            sf::Vertex* triangle = &m_vertices[fillStart + i * 3];
+            triangle[0] = sf::Vertex(center, fill);
+            triangle[1] = sf::Vertex(inner0, fill);
+            triangle[2] = sf::Vertex(inner1, fill);
+
+            if (outlined)
+            {
+                Vec2f outer0 = m_outer[i], outer1 = m_outer[next];
+                sf::Vertex* quad = &m_vertices[outlineStart + i * 6];
+                quad[0] = sf::Vertex(inner0, outline);
+                quad[1] = sf::Vertex(outer0, outline);
+                quad[2] = sf::Vertex(inner1, outline);
+                quad[3] = sf::Vertex(inner1, outline);
+                quad[4] = sf::Vertex(outer0, outline);
+                quad[5] = sf::Vertex(outer1, outline);
+            }
+        }
+    }
+
+    void draw(sf::RenderTarget& target) const
+    {
+        if (!m_vertices.empty())
+        {
+            target.draw(m_vertices.data(), m_vertices.size(), sf::Triangles);
+        }
+    }
+};
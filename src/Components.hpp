@@ -2,14 +2,10 @@
 
 #include "Vec2.hpp"
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdint>
 
-class Component
-{
-public:
-    bool exists = false;
-};
-
-class CTransform : public Component
+class CTransform
 {
 public:
     Vec2f pos       = { 0.0, 0.0 };
@@ -22,32 +18,50 @@ public:
 
 };
 
-class CShape : public Component
+// CTransform is stored as separate position / velocity / angle arrays inside the
+// EntityManager, so get<CTransform>() hands out references into those arrays
+class CTransformView
 {
 public:
-    sf::CircleShape circle;
+    Vec2f& pos;
+    Vec2f& velocity;
+    float& angle;
+};
+
+// What an entity looks like, as plain numbers. The polygon itself is only
+// built at render time by BatchRenderer, from a unit polygon shared by every
+// shape with the same point count, so changing a colour is just a store
+class CShape
+{
+public:
+    float       radius              = 0.0f;
+    float       outlineThickness    = 0.0f;
+    uint32_t    points              = 0;
+    uint32_t    fill                = 0;        // packed RGBA, as sf::Color::toInteger()
+    uint32_t    outline             = 0;
 
     CShape() = default;
     CShape(float radius, size_t points, const sf::Color & fill, const sf::Color & outline, float thickness)
-        : circle(radius, points)
-    {
-        circle.setFillColor(fill);
-        circle.setOutlineColor(outline);
-        circle.setOutlineThickness(thickness);
-        circle.setOrigin(radius, radius);
-    }
+        : radius(radius), outlineThickness(thickness), points((uint32_t)points)
+        , fill(fill.toInteger()), outline(outline.toInteger()) {}
+
+    sf::Color fillColor() const     { return sf::Color(fill); }
+    sf::Color outlineColor() const  { return sf::Color(outline); }
 };
 
-class CCollision : public Component
+class CCollision
 {
 public:
-    float radius = 0;
+    float       radius  = 0;
+    uint32_t    layer   = 0;        // the one layer bit this entity is on
+    uint32_t    mask    = 0;        // layers it looks for overlaps with, 0 if it only gets run into
+    bool        swept   = false;    // fast mover, tested along the whole path it took this tick
     CCollision() = default;
-    CCollision(float r)
-        : radius(r) {}
+    CCollision(float r, uint32_t layer = 0, uint32_t mask = 0, bool swept = false)
+        : radius(r), layer(layer), mask(mask), swept(swept) {}
 };
 
-class CScore : public Component
+class CScore
 {
 public:
     int score = 0;
@@ -57,18 +71,26 @@ public:
         : score(s) {}
 };
 
-class CLifespan : public Component
+class CLifespan
 {
 public:
     int lifespan        = 0;
-    int remaining       = 0;
+    int spawnFrame      = 0;
 
     CLifespan() = default;
-    CLifespan(int totalLifespan)
-        : lifespan(totalLifespan), remaining(totalLifespan) {}
+    CLifespan(int totalLifespan, int frame)
+        : lifespan(totalLifespan), spawnFrame(frame) {}
+
+    // 255 at spawn fading to 0 once the lifespan is used up, frame can be in between ticks
+    sf::Uint8 alpha(float frame) const
+    {
+        float remaining = (float)lifespan - (frame - (float)spawnFrame);
+        if (remaining <= 0.0f || lifespan <= 0) { return 0; }
+        return (sf::Uint8)(std::min(remaining / (float)lifespan, 1.0f) * 255);
+    }
 };
 
-class CInput : public Component
+class CInput
 {
 public:
     bool up     = false;
@@ -80,7 +102,7 @@ public:
     CInput() = default;
 };
 
-class CSpecial : public Component
+class CSpecial
 {
 public:
     int cooldown        = 0;
@@ -91,4 +113,12 @@ public:
     CSpecial() = default;
     CSpecial(int cooldown)
         : cooldown(cooldown) {}
+
+    // reinitialise in place, keeping the text and its string storage
+    void reset(int cooldownTicks)
+    {
+        cooldown = cooldownTicks;
+        lastfired = 0;
+        available = true;
+    }
 };
\ No newline at end of file
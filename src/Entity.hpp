@@ -1,7 +1,9 @@
 #pragma once
 
 #include "Components.hpp"
-#include <string>
+#include "EntityHandle.hpp"
+#include "Tags.hpp"
+#include <cstdint>
 #include <tuple>
 
 class EntityManager;
@@ -12,76 +14,82 @@ using ComponentTuple = std::tuple<
     CCollision,
     CInput,
     CScore,
-    CLifespan,
+    CLifespan
+>;
+
+// one-off data there is only ever one of, e.g. the player's special move and
+// its HUD text. The EntityManager holds a single instance of each instead of
+// a slot per entity
+using ResourceTuple = std::tuple<
     CSpecial
 >;
 
+// position of a component type in ComponentTuple, e.g. for building bitmasks of components
+template <typename T, typename Tuple> struct TupleIndex;
+template <typename T, typename... Ts>
+struct TupleIndex<T, std::tuple<T, Ts...>> { static constexpr size_t value = 0; };
+template <typename T, typename U, typename... Ts>
+struct TupleIndex<T, std::tuple<U, Ts...>> { static constexpr size_t value = 1 + TupleIndex<T, std::tuple<Ts...>>::value; };
+
+template <typename T>
+constexpr size_t ComponentIndex = TupleIndex<T, ComponentTuple>::value;
+
+template <typename T>
+constexpr size_t ResourceIndex = TupleIndex<T, ResourceTuple>::value;
+
+// one bit per component type, e.g. the set of components an entity has
+using ComponentMask = uint32_t;
+
+template <typename... Ts>
+constexpr ComponentMask componentMask()
+{
+    return ((ComponentMask(1) << ComponentIndex<Ts>) | ... | ComponentMask(0));
+}
+
+// An entity owns no data itself, it is a handle to a slot in the component
+// arrays held by the EntityManager that created it. Copying one is as cheap
+// as copying two pointers, and it can tell when the entity it names has died
 class Entity
 {
     friend class EntityManager;
 
-    ComponentTuple      m_components;
-    bool                m_active = true;
-    std::string         m_tag = "default";
-    size_t              m_id = 0;
+    EntityManager*      m_manager = nullptr;
+    EntityHandle        m_handle;
 
-    Entity(const size_t& id, const std::string& tag)
-        : m_tag(tag)
-        , m_id(id)
+    Entity(EntityManager* manager, const EntityHandle& handle)
+        : m_manager(manager)
+        , m_handle(handle)
         {}
 
 public:
 
-    bool isActive() const
-    {
-        return m_active;
-    }
+    Entity() = default;
 
-    void destroy()
-    {
-        m_active = false;
-    }
+    bool isActive() const;
+
+    void destroy() const;
 
     size_t id() const
     {
-        return m_id;
+        return m_handle.index;
     }
 
-    const std::string& tag() const
+    const EntityHandle& handle() const
     {
-        return m_tag;
+        return m_handle;
     }
 
+    TagId tag() const;
+
     template <typename T>
-    bool has() const
-    {
-        return get<T>().exists;
-    }
+    bool has() const;
 
     template <typename T, typename... TArgs>
-    T& add(TArgs&&... mArgs)
-    {
-        auto& component = get<T>();
-        component = T(std::forward<TArgs>(mArgs)...);
-        component.exists = true;
-        return component;
-    }
+    decltype(auto) add(TArgs&&... mArgs) const;
 
     template<typename T>
-    T& get()
-    {
-        return std::get<T>(m_components);
-    }
+    decltype(auto) get() const;
 
     template<typename T>
-    const T& get() const
-    {
-        return std::get<T>(m_components);
-    }
-
-    template<typename T>
-    void remove()
-    {
-        get<T>() = T();
-    }
-};
\ No newline at end of file
+    void remove() const;
+};
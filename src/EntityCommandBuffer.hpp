@@ -0,0 +1,282 @@
+#pragma once
+
+#include "Entity.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <variant>
+#include <vector>
+
+template <typename> struct ComponentVariantOf;
+template <typename... Ts>
+struct ComponentVariantOf<std::tuple<Ts...>> { using type = std::variant<Ts...>; };
+
+using ComponentVariant = ComponentVariantOf<ComponentTuple>::type;
+
+// Structural changes recorded now and applied later. Systems, worker threads
+// included, create entities, add components and destroy entities through the
+// buffer instead of the EntityManager, and the EntityManager applies every
+// recorded command in its next update(). Each thread records into its own
+// buffer, so recording takes no lock once a thread has its buffer.
+//
+// Commands are applied in order of their sort key, then in the order they
+// were recorded. Recorders that run one after another need no key. Recorders
+// that run at the same time should pass distinct keys, e.g. the slot of the
+// entity they are working on, or the order between them is up to the threads
+class EntityCommandBuffer
+{
+    friend class EntityManager;
+
+public:
+
+    // an entity that will be created by the next update(), components can be
+    // added to it in the meantime
+    class Pending
+    {
+        friend class EntityCommandBuffer;
+
+        uint32_t    m_buffer    = 0;
+        uint32_t    m_index     = 0;    // which create() of that buffer
+        uint64_t    m_sortKey   = 0;
+        uint64_t    m_sequence  = 0;
+    };
+
+private:
+
+    enum class Op : uint8_t { Create, Add, Destroy };
+
+    static constexpr uint32_t NotCreated = UINT32_MAX;
+
+    class Command
+    {
+    public:
+        uint64_t            sortKey     = 0;
+        uint64_t            sequence    = 0;        // global recording order
+        Op                  op          = Op::Create;
+        TagId               tag         = 0;
+        EntityHandle        target;
+        uint32_t            createdBuffer   = NotCreated;   // or the target is the createdIndex'th create() of this buffer
+        uint32_t            createdIndex    = 0;
+        ComponentVariant    component;
+    };
+
+    class Buffer
+    {
+    public:
+        std::thread::id         thread;                 // none yet for a buffer reserve() made up front
+        uint32_t                index       = 0;
+        std::vector<Command>    commands;
+        std::vector<Entity>     created;            // filled in as the creates are applied
+        uint32_t                creates     = 0;
+        bool                    keyed       = false;    // some command has a sort key
+    };
+
+    class Order
+    {
+    public:
+        uint64_t    sortKey;
+        uint64_t    sequence;
+        uint32_t    buffer;
+        uint32_t    command;
+
+        bool operator < (const Order& rhs) const
+        {
+            if (sortKey != rhs.sortKey) { return sortKey < rhs.sortKey; }
+            if (sequence != rhs.sequence) { return sequence < rhs.sequence; }
+            if (buffer != rhs.buffer) { return buffer < rhs.buffer; }
+            return command < rhs.command;
+        }
+    };
+
+    std::vector<std::unique_ptr<Buffer>>    m_buffers;          // one per thread that has recorded, never shrinks
+    std::mutex                              m_buffersMutex;
+    std::atomic<uint64_t>                   m_sequence { 0 };
+    std::vector<Order>                      m_order;            // scratch for merging the buffers
+    uint64_t                                m_id;               // tells apart buffers that reuse an address
+
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> id { 0 };
+        return ++id;
+    }
+
+    Buffer& addBuffer()
+    {
+        m_buffers.push_back(std::make_unique<Buffer>());
+        m_buffers.back()->index = (uint32_t)(m_buffers.size() - 1);
+        return *m_buffers.back();
+    }
+
+    // the calling thread's buffer, looked up under the lock only the first time.
+    // A thread new to the buffer takes one reserve() made if there is one left
+    Buffer& local()
+    {
+        thread_local uint64_t   t_owner = 0;
+        thread_local Buffer*    t_buffer = nullptr;
+        if (t_owner == m_id) { return *t_buffer; }
+
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        std::thread::id self = std::this_thread::get_id();
+        auto it = std::find_if(m_buffers.begin(), m_buffers.end(), [&](auto& b) { return b->thread == self; });
+        if (it == m_buffers.end())
+        {
+            it = std::find_if(m_buffers.begin(), m_buffers.end(), [](auto& b) { return b->thread == std::thread::id(); });
+            if (it == m_buffers.end())
+            {
+                addBuffer();
+                it = m_buffers.end() - 1;
+            }
+            (*it)->thread = self;
+        }
+
+        t_owner = m_id;
+        t_buffer = it->get();
+        return *t_buffer;
+    }
+
+    Command& record(Buffer& buffer, Op op, uint64_t sortKey, uint64_t sequence)
+    {
+        Command& command = buffer.commands.emplace_back();
+        command.op = op;
+        command.sortKey = sortKey;
+        command.sequence = sequence;
+        buffer.keyed |= sortKey != 0;
+        return command;
+    }
+
+    uint64_t nextSequence()
+    {
+        return m_sequence.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // calls f(command) for every command of every buffer, in the order they
+    // are to be applied in. Only called by update(), while nothing is recording
+    template <typename F>
+    void forEach(F&& f)
+    {
+        Buffer* only = nullptr;
+        size_t recording = 0;
+        for (auto& buffer : m_buffers)
+        {
+            buffer->created.resize(buffer->creates);
+            if (!buffer->commands.empty()) { only = buffer.get(); recording++; }
+        }
+
+        // one thread recording without keys, the usual case, is already in order
+        if (recording == 1 && !only->keyed)
+        {
+            for (const Command& command : only->commands) { f(command); }
+            return;
+        }
+
+        m_order.clear();
+        for (auto& buffer : m_buffers)
+        {
+            for (uint32_t i = 0; i < buffer->commands.size(); i++)
+            {
+                const Command& c = buffer->commands[i];
+                m_order.push_back({ c.sortKey, c.sequence, buffer->index, i });
+            }
+        }
+        std::sort(m_order.begin(), m_order.end());
+
+        for (const Order& order : m_order)
+        {
+            f(m_buffers[order.buffer]->commands[order.command]);
+        }
+    }
+
+    // where the entity made by a create() goes, or was put by the time an add() to it is applied
+    Entity& created(uint32_t buffer, uint32_t index)
+    {
+        return m_buffers[buffer]->created[index];
+    }
+
+    void clear()
+    {
+        for (auto& buffer : m_buffers)
+        {
+            buffer->commands.clear();
+            buffer->creates = 0;
+            buffer->keyed = false;
+        }
+    }
+
+public:
+
+    EntityCommandBuffer()
+        : m_id(nextId())
+    {}
+
+    EntityCommandBuffer(const EntityCommandBuffer&) = delete;
+    EntityCommandBuffer& operator = (const EntityCommandBuffer&) = delete;
+
+    Pending create(TagId tag, uint64_t sortKey = 0)
+    {
+        Buffer& buffer = local();
+        Command& command = record(buffer, Op::Create, sortKey, nextSequence());
+        command.tag = tag;
+        command.createdBuffer = buffer.index;
+        command.createdIndex = buffer.creates;
+
+        Pending pending;
+        pending.m_buffer = buffer.index;
+        pending.m_index = buffer.creates++;
+        pending.m_sortKey = sortKey;
+        pending.m_sequence = command.sequence;
+        return pending;
+    }
+
+    // component T built from args, added to an entity created through the buffer
+    // on the same thread. It shares the create's place in the order and comes
+    // right after it, being later in the same buffer
+    template <typename T, typename... TArgs>
+    void add(const Pending& entity, TArgs&&... mArgs)
+    {
+        Command& command = record(local(), Op::Add, entity.m_sortKey, entity.m_sequence);
+        command.createdBuffer = entity.m_buffer;
+        command.createdIndex = entity.m_index;
+        command.component.template emplace<T>(std::forward<TArgs>(mArgs)...);
+    }
+
+    // component T built from args, added to an existing entity if it is still alive by then
+    template <typename T, typename... TArgs>
+    void add(const EntityHandle& entity, TArgs&&... mArgs)
+    {
+        Command& command = record(local(), Op::Add, 0, nextSequence());
+        command.target = entity;
+        command.component.template emplace<T>(std::forward<TArgs>(mArgs)...);
+    }
+
+    void destroy(const EntityHandle& entity, uint64_t sortKey = 0)
+    {
+        Command& command = record(local(), Op::Destroy, sortKey, nextSequence());
+        command.target = entity;
+    }
+
+    // makes a buffer for each of this many threads up front, each with room
+    // for this many commands, so recording doesn't allocate until one outgrows it
+    void reserve(size_t threads, size_t commands)
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        while (m_buffers.size() < threads) { addBuffer(); }
+        for (auto& buffer : m_buffers)
+        {
+            buffer->commands.reserve(commands);
+            buffer->created.reserve(commands);
+        }
+        m_order.reserve(commands * m_buffers.size());
+    }
+
+    // commands waiting for the next update(), across every thread's buffer
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        size_t count = 0;
+        for (auto& buffer : m_buffers) { count += buffer->commands.size(); }
+        return count;
+    }
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+// Slot index plus the generation that slot had when the entity was created.
+// Slots are recycled once an entity dies and every reuse bumps the generation,
+// so a handle that outlived its entity is caught with a single compare
+class EntityHandle
+{
+public:
+    static constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+    uint32_t    index       = InvalidIndex;
+    uint32_t    generation  = 0;
+
+    EntityHandle() = default;
+    EntityHandle(uint32_t i, uint32_t g)
+        : index(i), generation(g) {}
+
+    bool operator == (const EntityHandle& rhs) const = default;
+};
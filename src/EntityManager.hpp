@@ -1,59 +1,305 @@
 #pragma once
 
 #include "Entity.hpp"
+#include "EntityCommandBuffer.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
-using EntityVec = std::vector<std::shared_ptr<Entity>>;
+using EntityVec = std::vector<Entity>;
+
+// Dense storage for one component type, indexed by entity id
+template <typename T>
+class ComponentArray
+{
+    std::vector<T>          m_data;
+    std::vector<uint8_t>    m_has;
+
+public:
+
+    void resize(size_t size)
+    {
+        m_data.resize(size);
+        m_has.resize(size, 0);
+    }
+
+    bool has(size_t id) const
+    {
+        return m_has[id];
+    }
+
+    T& get(size_t id)
+    {
+        return m_data[id];
+    }
+
+    template <typename... TArgs>
+    T& add(size_t id, TArgs&&... mArgs)
+    {
+        m_data[id] = T(std::forward<TArgs>(mArgs)...);
+        m_has[id] = 1;
+        return m_data[id];
+    }
+
+    void remove(size_t id)
+    {
+        m_data[id] = T();
+        m_has[id] = 0;
+    }
+
+    std::vector<T>& data()
+    {
+        return m_data;
+    }
+};
+
+// Transforms are split into one array per field so that movement and
+// collision only stream through the data they actually read. The previous
+// tick's positions and angles are kept so rendering can interpolate
+template <>
+class ComponentArray<CTransform>
+{
+    std::vector<Vec2f>      m_positions;
+    std::vector<Vec2f>      m_velocities;
+    std::vector<float>      m_angles;
+    std::vector<Vec2f>      m_prevPositions;
+    std::vector<float>      m_prevAngles;
+    std::vector<uint8_t>    m_has;
+
+public:
+
+    void resize(size_t size)
+    {
+        m_positions.resize(size);
+        m_velocities.resize(size);
+        m_angles.resize(size);
+        m_prevPositions.resize(size);
+        m_prevAngles.resize(size);
+        m_has.resize(size, 0);
+    }
+
+    bool has(size_t id) const
+    {
+        return m_has[id];
+    }
+
+    CTransformView get(size_t id)
+    {
+        return { m_positions[id], m_velocities[id], m_angles[id] };
+    }
+
+    template <typename... TArgs>
+    CTransformView add(size_t id, TArgs&&... mArgs)
+    {
+        CTransform transform(std::forward<TArgs>(mArgs)...);
+        m_positions[id] = transform.pos;
+        m_velocities[id] = transform.velocity;
+        m_angles[id] = transform.angle;
+        m_prevPositions[id] = transform.pos;
+        m_prevAngles[id] = transform.angle;
+        m_has[id] = 1;
+        return get(id);
+    }
+
+    void remove(size_t id)
+    {
+        m_positions[id] = Vec2f();
+        m_velocities[id] = Vec2f();
+        m_angles[id] = 0.0f;
+        m_prevPositions[id] = Vec2f();
+        m_prevAngles[id] = 0.0f;
+        m_has[id] = 0;
+    }
+
+    // snapshot the current transforms at the start of a simulation tick
+    void storePrevious()
+    {
+        std::copy(m_positions.begin(), m_positions.end(), m_prevPositions.begin());
+        std::copy(m_angles.begin(), m_angles.end(), m_prevAngles.begin());
+    }
+
+    std::vector<Vec2f>& positions()     { return m_positions; }
+    std::vector<Vec2f>& velocities()    { return m_velocities; }
+    std::vector<float>& angles()        { return m_angles; }
+    std::vector<Vec2f>& prevPositions() { return m_prevPositions; }
+    std::vector<float>& prevAngles()    { return m_prevAngles; }
+};
+
+template <typename> struct ComponentArrays;
+template <typename... Ts>
+struct ComponentArrays<std::tuple<Ts...>> { using type = std::tuple<ComponentArray<Ts>...>; };
+
+using ComponentArrayTuple = ComponentArrays<ComponentTuple>::type;
 
 class EntityManager
 {
+    // set in an entity's mask from addEntity() until destroy(), so a view's
+    // match is a single compare
+    static constexpr ComponentMask AliveBit = ComponentMask(1) << 31;
+    static_assert(std::tuple_size_v<ComponentTuple> < 31, "component bits overlap the alive bit");
+
+    ComponentArrayTuple                 m_components;       // one dense array per component type
+    ResourceTuple                       m_resources;        // one instance per resource type
+    std::vector<ComponentMask>          m_masks;            // components each slot has, plus AliveBit
+    std::vector<TagId>                  m_tags;             // tag of each entity slot
+    std::vector<uint8_t>                m_active;           // whether each entity slot is alive
+    std::vector<uint32_t>               m_generations;      // bumped every time a slot is freed
+    std::vector<size_t>                 m_freeIds;          // slots of dead entities ready for reuse
+    std::vector<size_t>                 m_killList;         // slots destroyed since the last update, one entry per slot at most
+    std::atomic<size_t>                 m_killCount { 0 };  // entries used in m_killList, systems may destroy from several threads
+    std::vector<uint32_t>               m_entityIndex;      // where each slot sits in m_entities
+    std::vector<uint32_t>               m_tagIndex;         // where each slot sits in its tag's list in m_entityMap
     EntityVec                           m_entities;
     EntityVec                           m_entitiesToAdd;
-    std::map<std::string, EntityVec>    m_entityMap;
+    EntityVec                           m_addedEntities;    // the entities the last update() added
+    EntityCommandBuffer                 m_commands;         // structural changes recorded by the systems
+    std::vector<EntityVec>              m_entityMap;        // entities of each tag, indexed by TagId
+    std::vector<std::string>            m_tagNames;         // name of each interned tag, indexed by TagId
     size_t                              m_totalEntities = 0;
+    size_t                              m_usedSlots = 0;    // slots handed out at least once, the rest are spare capacity
+
+    // O(1) removal that doesn't keep the order: the last entity moves into the hole
+    static void swapRemove(EntityVec& vec, std::vector<uint32_t>& index, size_t id)
+    {
+        uint32_t i = index[id];
+        Entity last = vec.back();
+        vec[i] = last;
+        index[last.id()] = i;
+        vec.pop_back();
+    }
+
+    // runs everything recorded in m_commands since the last update, in the buffer's order
+    void applyCommands();
+
+    // clear every component of a dead entity and hand its slot back for reuse
+    void freeEntity(size_t id)
+    {
+        std::apply([id](auto&... arrays) { (arrays.remove(id), ...); }, m_components);
+        m_masks[id] = 0;
+        m_generations[id]++;
+        m_freeIds.push_back(id);
+    }
+
+    size_t nextEntityId()
+    {
+        if (!m_freeIds.empty())
+        {
+            size_t id = m_freeIds.back();
+            m_freeIds.pop_back();
+            return id;
+        }
 
-    void removeDeadEntities(EntityVec& vec)
+        // out of slots: double them, so growing happens a handful of times instead of once per new entity
+        if (m_usedSlots == m_active.size())
+        {
+            resizeSlots(std::max<size_t>(64, m_active.size() * 2));
+        }
+        return m_usedSlots++;
+    }
+
+    void resizeSlots(size_t slots)
     {
-        std::erase_if(vec, [](auto const& e) { return !(e->isActive()); });
+        std::apply([slots](auto&... arrays) { (arrays.resize(slots), ...); }, m_components);
+        m_masks.resize(slots, 0);
+        m_tags.resize(slots);
+        m_active.resize(slots, 0);
+        m_generations.resize(slots, 0);
+        m_killList.resize(slots);
+        m_entityIndex.resize(slots);
+        m_tagIndex.resize(slots);
     }
 
 public:
 
-    EntityManager() = default;
+    EntityManager()
+        : m_entityMap(Tag::BuiltinCount)
+        , m_tagNames(Tag::BuiltinNames, Tag::BuiltinNames + Tag::BuiltinCount)
+    {}
+
+    // sizes the slots and every entity list for this many entities at once,
+    // so a game that stays under it never grows them while it plays
+    void reserve(size_t entities)
+    {
+        if (entities > m_active.size()) { resizeSlots(entities); }
+        m_freeIds.reserve(entities);
+        m_entities.reserve(entities);
+        m_entitiesToAdd.reserve(entities);
+        m_addedEntities.reserve(entities);
+        for (auto& tagged : m_entityMap) { tagged.reserve(entities); }
+    }
 
     void update()
     {
+        TRACE_SCOPE("EntityManager::update");
+
+        applyCommands();
+
         // Add entities from m_entitiesToAdd to the proper locations(s)
         for (auto& e : m_entitiesToAdd)
         {
+            m_entityIndex[e.id()] = (uint32_t)m_entities.size();
             m_entities.push_back(e);
-            // not sure if this is needed here because it seems that entities
-            // are being added to the map at the time of creation within addEntity()
-            // m_entityMap[e->tag()].push_back(e);
+
+            auto& tagged = m_entityMap[m_tags[e.id()]];
+            m_tagIndex[e.id()] = (uint32_t)tagged.size();
+            tagged.push_back(e);
         }
+        m_addedEntities.swap(m_entitiesToAdd);
         m_entitiesToAdd.clear();
 
-        // remove dead entities from the vector of all entities
-        removeDeadEntities(m_entities);
+        // only the entities destroyed since the last update are touched, not every list
+        size_t killed = m_killCount.exchange(0);
+        for (size_t k = 0; k < killed; k++)
+        {
+            size_t id = m_killList[k];
+            swapRemove(m_entities, m_entityIndex, id);
+            swapRemove(m_entityMap[m_tags[id]], m_tagIndex, id);
+            freeEntity(id);
+        }
+    }
 
-        // remove dead entities from each vector in the entity map
-        // C++20 way of iterating through [key,value] pairs in a map
-        for (auto& [tag, entityVec] : m_entityMap)
+    // returns the id of a tag name, interning it the first time it is seen
+    // interning grows m_entityMap, so don't do it while iterating over getEntities()
+    TagId tagId(const std::string& name)
+    {
+        for (size_t i = 0; i < m_tagNames.size(); i++)
         {
-            removeDeadEntities(entityVec);
+            if (m_tagNames[i] == name) { return (TagId)i; }
         }
+
+        m_tagNames.push_back(name);
+        m_entityMap.emplace_back();
+        return (TagId)(m_tagNames.size() - 1);
     }
 
-    std::shared_ptr<Entity> addEntity(const std::string& tag)
+    const std::string& tagName(TagId tag) const
     {
-        // create the entity shared pointer
-        auto entity = std::shared_ptr<Entity>(new Entity(m_totalEntities++, tag));
+        return m_tagNames[tag];
+    }
 
-        // add it to the vec of all entities
-        m_entitiesToAdd.push_back(entity);
+    Entity addEntity(const std::string& tag)
+    {
+        return addEntity(tagId(tag));
+    }
 
-        // add it to the entity map
-        if (m_entityMap.find(tag) == m_entityMap.end()) { m_entityMap[tag] = EntityVec(); }
-        m_entityMap[tag].push_back(entity);
+    Entity addEntity(TagId tag)
+    {
+        // grab a free slot in the component arrays
+        size_t id = nextEntityId();
+        m_tags[id] = tag;
+        m_masks[id] = AliveBit;
+        m_active[id] = 1;
+        m_totalEntities++;
+
+        Entity entity(this, EntityHandle((uint32_t)id, m_generations[id]));
+
+        // it joins the vec of all entities and the entity map at the next update
+        m_entitiesToAdd.push_back(entity);
 
         return entity;
     }
@@ -63,14 +309,262 @@ public:
         return m_entities;
     }
 
-    const EntityVec& getEntities(const std::string& tag)
+    // the entities the last update() added to getEntities(), some may already be dead
+    const EntityVec& getAddedEntities()
+    {
+        return m_addedEntities;
+    }
+
+    // where systems record spawns and other structural changes, see EntityCommandBuffer
+    EntityCommandBuffer& commands()
+    {
+        return m_commands;
+    }
+
+    const EntityVec& getEntities(TagId tag)
     {
-        if (m_entityMap.find(tag) == m_entityMap.end()) { m_entityMap[tag] = EntityVec(); }
         return m_entityMap[tag];
     }
 
-    const std::map<std::string, EntityVec>& getEntityMap()
+    const EntityVec& getEntities(const std::string& tag)
+    {
+        return getEntities(tagId(tag));
+    }
+
+    const std::vector<EntityVec>& getEntityMap()
     {
         return m_entityMap;
     }
-};
\ No newline at end of file
+
+    // number of entity slots, systems can loop over [0, size()) to walk the component arrays linearly
+    size_t size() const
+    {
+        return m_usedSlots;
+    }
+
+    bool isActive(size_t id) const
+    {
+        return m_active[id];
+    }
+
+    // O(1): a stale handle points at a slot whose generation has moved on
+    bool isActive(const EntityHandle& handle) const
+    {
+        return handle.index < m_active.size()
+            && m_generations[handle.index] == handle.generation
+            && m_active[handle.index];
+    }
+
+    // returns an entity that is not active if the handle is stale
+    Entity getEntity(const EntityHandle& handle)
+    {
+        return Entity(this, handle);
+    }
+
+    // safe to call from several threads at once, on the same slot too: only the
+    // call that clears the active flag records the slot for removal
+    void destroy(size_t id)
+    {
+        if (!std::atomic_ref<uint8_t>(m_active[id]).exchange(0, std::memory_order_acq_rel)) { return; }
+
+        m_masks[id] &= ~AliveBit;
+        m_killList[m_killCount.fetch_add(1, std::memory_order_relaxed)] = id;
+    }
+
+    // generations only change in update(), so checking the handle doesn't race other destroys
+    void destroy(const EntityHandle& handle)
+    {
+        if (handle.index < m_active.size() && m_generations[handle.index] == handle.generation) { destroy(handle.index); }
+    }
+
+    TagId tag(size_t id) const
+    {
+        return m_tags[id];
+    }
+
+    // tag of every slot, for kernels that walk the slots in bulk
+    const std::vector<TagId>& tags() const
+    {
+        return m_tags;
+    }
+
+    // references into the arrays are invalidated when addEntity has to grow them
+    template <typename T>
+    ComponentArray<T>& getComponents()
+    {
+        return std::get<ComponentArray<T>>(m_components);
+    }
+
+    template <typename T>
+    T& resource()
+    {
+        return std::get<T>(m_resources);
+    }
+
+    template <typename T>
+    bool has(size_t id)
+    {
+        return getComponents<T>().has(id);
+    }
+
+    template <typename T>
+    decltype(auto) get(size_t id)
+    {
+        return getComponents<T>().get(id);
+    }
+
+    template <typename T, typename... TArgs>
+    decltype(auto) add(size_t id, TArgs&&... mArgs)
+    {
+        m_masks[id] |= componentMask<T>();
+        return getComponents<T>().add(id, std::forward<TArgs>(mArgs)...);
+    }
+
+    template <typename T>
+    void remove(size_t id)
+    {
+        m_masks[id] &= ~componentMask<T>();
+        getComponents<T>().remove(id);
+    }
+
+    // Live entities that have every component in Ts, e.g.
+    //     for (auto [e, transform, shape] : m_entities.view<CTransform, CShape>())
+    // Slots are walked in order and each is skipped on one compare of its
+    // component mask. Components are looked up as each entity is reached, so
+    // the loop may add entities; ones added during it may or may not be visited
+    template <typename... Ts>
+    class View
+    {
+        static constexpr ComponentMask Wanted = componentMask<Ts...>() | AliveBit;
+
+        EntityManager*  m_manager;
+        size_t          m_end;
+
+    public:
+
+        class Iterator
+        {
+            EntityManager*  m_manager;
+            size_t          m_id;
+            size_t          m_end;
+
+            void skip()
+            {
+                while (m_id < m_end && (m_manager->m_masks[m_id] & Wanted) != Wanted) { m_id++; }
+            }
+
+        public:
+
+            Iterator(EntityManager* manager, size_t id, size_t end)
+                : m_manager(manager), m_id(id), m_end(end)
+            {
+                skip();
+            }
+
+            // (entity, component...), the same types Entity::get<T>() returns
+            auto operator * () const
+            {
+                Entity entity(m_manager, EntityHandle((uint32_t)m_id, m_manager->m_generations[m_id]));
+                return std::tuple<Entity, decltype(m_manager->get<Ts>(m_id))...>(entity, m_manager->get<Ts>(m_id)...);
+            }
+
+            Iterator& operator ++ ()
+            {
+                m_id++;
+                skip();
+                return *this;
+            }
+
+            bool operator != (const Iterator& rhs) const
+            {
+                return m_id != rhs.m_id;
+            }
+        };
+
+        View(EntityManager* manager)
+            : m_manager(manager), m_end(manager->size())
+        {}
+
+        Iterator begin() const { return Iterator(m_manager, 0, m_end); }
+        Iterator end() const { return Iterator(m_manager, m_end, m_end); }
+    };
+
+    template <typename... Ts>
+    View<Ts...> view()
+    {
+        return View<Ts...>(this);
+    }
+};
+
+inline void EntityManager::applyCommands()
+{
+    using Op = EntityCommandBuffer::Op;
+
+    m_commands.forEach([this](const EntityCommandBuffer::Command& command)
+    {
+        switch (command.op)
+        {
+        case Op::Create:
+            m_commands.created(command.createdBuffer, command.createdIndex) = addEntity(command.tag);
+            break;
+
+        case Op::Add:
+        {
+            Entity entity = command.createdBuffer == EntityCommandBuffer::NotCreated
+                ? getEntity(command.target)
+                : m_commands.created(command.createdBuffer, command.createdIndex);
+            if (!isActive(entity.handle())) { break; }
+
+            std::visit([&](const auto& component)
+            {
+                add<std::decay_t<decltype(component)>>(entity.id(), component);
+            }, command.component);
+            break;
+        }
+
+        case Op::Destroy:
+            destroy(command.target);
+            break;
+        }
+    });
+    m_commands.clear();
+}
+
+inline bool Entity::isActive() const
+{
+    return m_manager->isActive(m_handle);
+}
+
+inline void Entity::destroy() const
+{
+    m_manager->destroy(m_handle);
+}
+
+inline TagId Entity::tag() const
+{
+    return m_manager->tag(m_handle.index);
+}
+
+template <typename T>
+bool Entity::has() const
+{
+    return m_manager->has<T>(m_handle.index);
+}
+
+template <typename T, typename... TArgs>
+decltype(auto) Entity::add(TArgs&&... mArgs) const
+{
+    return m_manager->add<T>(m_handle.index, std::forward<TArgs>(mArgs)...);
+}
+
+template <typename T>
+decltype(auto) Entity::get() const
+{
+    return m_manager->get<T>(m_handle.index);
+}
+
+template <typename T>
+void Entity::remove() const
+{
+    m_manager->remove<T>(m_handle.index);
+}
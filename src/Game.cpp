@@ -1,19 +1,51 @@
 #include "Game.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <math.h>
 #include <random>
 
+namespace
+{
+    // built once, so changing the special move text copies into the text's existing storage
+    const sf::String SpecialAvailableText("Special Move Available!");
+    const sf::String SpecialCooldownText("Special Move on Cooldown!");
+
+    // whether two circles moving in straight lines, a from a0 to a1 and b from
+    // b0 to b1, come closer than r to each other at any point of the tick
+    bool sweptOverlap(const Vec2f& a0, const Vec2f& a1, const Vec2f& b0, const Vec2f& b1, float r)
+    {
+        // in a's frame b starts at d and moves by v, the closest approach is at t in [0, 1]
+        Vec2f d = b0 - a0;
+        Vec2f v = (b1 - b0) - (a1 - a0);
+        float vv = v.lengthSquared();
+        float t = vv > 0.0f ? std::clamp(-d.dot(v) / vv, 0.0f, 1.0f) : 0.0f;
+        return (d + v * t).lengthSquared() < r * r;
+    }
+}
+
 Game::Game(const std::string& config)
 {
     init(config);
 }
 
+Game::Game(const GameOptions& options)
+    : m_options(options)
+    , m_jobs(options.threads)
+{
+    init(options.config);
+}
+
 void Game::init(const std::string& path)
 {
     // read in config file here
-    std::ifstream fin("config.txt");
+    std::ifstream fin(path);
+    if (!fin)
+    {
+        std::cerr << "Could not open config file " << path << "!\n";
+        exit(-1);
+    }
     std::string temp;
     int wWidth{}, wHeight{};
 
@@ -23,7 +55,12 @@ void Game::init(const std::string& path)
         {
             int wFramerateLimit{}, wFullScreen{};
             fin >> wWidth >> wHeight >> wFramerateLimit >> wFullScreen;
-            if (wFullScreen)
+            m_windowSize = sf::Vector2u(wWidth, wHeight);
+            if (m_options.headless)
+            {
+                continue;
+            }
+            else if (wFullScreen)
             {
                 m_window.create(sf::VideoMode(wWidth, wHeight), "Geometric Wars", sf::Style::Fullscreen);
             }
@@ -31,6 +68,7 @@ void Game::init(const std::string& path)
             {
                 m_window.create(sf::VideoMode(wWidth, wHeight), "Geometric Wars");
             }
+            // only caps the render rate, the simulation always ticks at 1 / TickTime
             m_window.setFramerateLimit(wFramerateLimit);
         }
         else if (temp == "Font")
@@ -44,6 +82,8 @@ void Game::init(const std::string& path)
                 fin >> fontColor[i];
             }
 
+            if (m_options.headless) { continue; }
+
             if (!m_font.loadFromFile(fontFilename))
             {
                 std::cerr << "Could not load font!\n";
@@ -82,47 +122,227 @@ void Game::init(const std::string& path)
     m_colorDist = std::uniform_int_distribution<int>(0, 255);
     m_random = std::uniform_real_distribution<float>(0.0f, 1.0f);
 
+    // a cell twice the largest collision radius keeps every query to a handful of cells
+    m_collisionGrid = SpatialHash(2.0f * std::max({ m_playerConfig.CR, m_enemyConfig.CR, m_bulletConfig.CR }));
+    m_enemyIndex = SpatialIndex({ Tag::Enemy, Tag::SmallEnemy }, 2.0f * m_enemyConfig.SR);
+
+    // everything a tick fills is sized up front, so once the pools are warm a
+    // game that stays under ReservedEntities doesn't touch the heap
+    m_entities.reserve(ReservedEntities);
+    m_entities.commands().reserve(m_jobs.threadCount(), ReservedCommands);
+    m_collisionGrid.reserve(ReservedEntities);
+    m_enemyIndex.reserve(ReservedEntities, 1);
+    m_nearestEnemies.reserve(1);
+    m_colliders.reserve(ReservedEntities);
+    m_contacts.reserve(ReservedEntities);
+    m_contactChunks.resize(m_jobs.threadCount() * 4);
+    for (auto& chunk : m_contactChunks) { chunk.reserve(ReservedEntities / 4); }
+    m_lifespanTimers.reserve(ReservedEntities);
+    m_cooldownTimers.reserve(16);
+    m_allyIds.reserve(64);
+    m_allyPositions.reserve(64);
+    m_allyDistances.reserve(64);
+    m_orbitIds.reserve(64);
+    m_orbitDirections.reserve(64);
+    if (m_options.seed) { m_randomGen.seed(*m_options.seed); }
 
-    ImGui::SFML::Init(m_window);
+    // which layers run into which, and what happens when they do
+    setContact(Layer::Enemy, Layer::Player, ContactKind::EnemyPlayer);
+    setContact(Layer::Enemy, Layer::Shot, ContactKind::EnemyShot);
+    setContact(Layer::SmallEnemy, Layer::Player, ContactKind::SmallEnemyPlayer);
+    setContact(Layer::SmallEnemy, Layer::Shot, ContactKind::SmallEnemyShot);
 
-    // scale the imgui ui and text size by 2
-    ImGui::GetStyle().ScaleAllSizes(2.0f);
-    ImGui::GetIO().FontGlobalScale = 2.0f;
+    if (!m_options.inputScript.empty()) { loadScript(m_options.inputScript); }
 
+    if (!m_options.headless)
+    {
+        ImGui::SFML::Init(m_window);
+
+        // scale the imgui ui and text size by 2
+        ImGui::GetStyle().ScaleAllSizes(2.0f);
+        ImGui::GetIO().FontGlobalScale = 2.0f;
+    }
+
+    initScheduler();
     spawnPlayer();
 }
 
-std::shared_ptr<Entity> Game::player()
+// a's CCollision mask picks up layer b, only a looks for the overlap so each pair is found once
+void Game::setContact(uint32_t a, uint32_t b, ContactKind kind)
+{
+    m_contactKinds[Layer::index(a)][Layer::index(b)] = kind;
+    m_layerMasks[Layer::index(a)] |= b;
+}
+
+// Systems are listed in the order they used to run one after another. Each
+// one waits only for the earlier ones whose reads / writes overlap its own,
+// e.g. sCooldown and sMovement's player input don't conflict
+void Game::initScheduler()
+{
+    using namespace Access;
+
+    // spawns are recorded into the entity command buffer, which any thread may
+    // do at any time, and only show up at the next EntityManager::update()
+    m_scheduler.add("sEnemySpawner", 0,
+        GameState,
+        [this]() { if (m_spawning) { auto timer = m_profiler.time("sEnemySpawner"); sEnemySpawner(); } });
+
+    m_scheduler.add("sSmallAllyBulletSpawner", Entities | Alive | components<CTransform>(),
+        GameState,
+        [this]() { if (m_spawning) { auto timer = m_profiler.time("sSmallAllyBulletSpawner"); sSmallAllyBulletSpawner(); } });
+
+    // the frame counter is game state, the timer wheel is only advanced here
+    m_scheduler.add("sLifespan", Entities | GameState,
+        Alive,
+        [this]() { if (m_lifespan) { auto timer = m_profiler.time("sLifespan"); sLifespan(); } });
+
+    m_scheduler.add("sCooldown", Entities | GameState,
+        resources<CSpecial>(),
+        [this]() { if (m_cooldown) { auto timer = m_profiler.time("sCooldown"); sCooldown(); } });
+
+    m_scheduler.add("sMovement", Entities | Alive | GameState | components<CInput>(),
+        components<CTransform>(),
+        [this]() { if (m_movement) { auto timer = m_profiler.time("sMovement"); sMovement(); } });
+
+    // detection bounces enemies, pushes the player back and fills the contacts
+    m_scheduler.add("sCollision", Entities | Alive | GameState | components<CCollision>(),
+        GameState | components<CTransform>(),
+        [this]() { if (m_collision) { auto timer = m_profiler.time("sCollision"); sCollision(); } });
+
+    m_scheduler.add("sCollisionResponse", Entities | GameState | components<CTransform, CShape, CScore>(),
+        Alive | GameState,
+        [this]() { if (m_collision) { auto timer = m_profiler.time("sCollisionResponse"); sCollisionResponse(); } });
+}
+
+void Game::loadScript(const std::string& path)
 {
-    auto& players = m_entities.getEntities("player");
-    //assert(players.size() == 1);
-    return players.front();
+    std::ifstream fin(path);
+    if (!fin)
+    {
+        std::cerr << "Could not open input script " << path << "!\n";
+        exit(-1);
+    }
+
+    ScriptedInput input;
+    while (fin >> input.frame >> input.action)
+    {
+        if (input.action == "shoot" || input.action == "up" || input.action == "down"
+            || input.action == "left" || input.action == "right")
+        {
+            fin >> input.x;
+        }
+        if (input.action == "shoot")
+        {
+            fin >> input.y;
+        }
+        m_script.push_back(input);
+    }
+
+    std::stable_sort(m_script.begin(), m_script.end(), [](auto& a, auto& b) { return a.frame < b.frame; });
+}
+
+Entity Game::player()
+{
+    return m_entities.getEntity(m_player);
 }
 
 void Game::run()
 {
+    sf::Clock runClock;
+
     while (m_running)
     {
-        // update the entity manager
-        m_entities.update();
+        TRACE_SCOPE("frame");
+        uint64_t allocationsBefore = HeapStats::allocations();
 
-        // required update call to imgui
-        ImGui::SFML::Update(m_window, m_deltaClock.restart());
-
-        if (m_spawning) { sEnemySpawner(); sSmallAllyBulletSpawner(); }
-        if(m_lifespan) { sLifespan(); }
-        if(m_movement) { sMovement(); }
-        if(m_collision) { sCollision(); }
-        if(m_cooldown) { sCooldown(); }
-        sUserInput();
-        sGUI();
-        sRender();
-        
-        if (!m_paused)
+        if (m_options.headless)
+        {
+            // nothing to keep in sync with, so simulate as fast as possible
+            tick();
+        }
+        else
+        {
+            sf::Time frameTime = m_deltaClock.restart();
+
+            // required update call to imgui
+            { auto timer = m_profiler.time("ImGui::Update"); ImGui::SFML::Update(m_window, frameTime); }
+            { auto timer = m_profiler.time("sUserInput"); sUserInput(); }
+
+            // run as many fixed ticks as the real time that passed, a long
+            // frame is clamped so the simulation can't fall further and further behind
+            m_accumulator += std::min(frameTime.asSeconds(), MaxFrameTime);
+            while (m_accumulator >= TickTime && m_running)
+            {
+                tick();
+                m_accumulator -= TickTime;
+            }
+
+            { auto timer = m_profiler.time("sGUI"); sGUI(); }
+            { auto timer = m_profiler.time("sRender"); sRender(m_accumulator / TickTime); }
+        }
+        m_profiler.endFrame();
+
+        // the first second fills the pools and grows the arrays, after that gameplay shouldn't allocate
+        m_frameAllocations = HeapStats::allocations() - allocationsBefore;
+        if (m_currentFrame > WarmupTicks) { m_steadyAllocations += m_frameAllocations; }
+
+        if (m_options.frames >= 0 && m_currentFrame >= m_options.frames)
         {
-            m_currentFrame++;
+            m_running = false;
         }
     }
+
+    if (m_options.headless)
+    {
+        std::cout << "frames: " << m_currentFrame
+                  << " score: " << m_score
+                  << " entities: " << m_entities.getEntities().size()
+                  << " allocations after warm-up: " << m_steadyAllocations
+                  << " time: " << runClock.getElapsedTime().asSeconds() << "s\n";
+    }
+}
+
+void Game::tick()
+{
+    TRACE_SCOPE("tick");
+    // replayed input lands where sUserInput's does in live play, before the tick it belongs to
+    { auto timer = m_profiler.time("sScriptedInput"); sScriptedInput(); }
+
+    // update the entity manager
+    {
+        auto timer = m_profiler.time("EntityManager::update");
+        m_entities.update();
+        m_entities.getComponents<CTransform>().storePrevious();
+    }
+
+    // a player killed last tick comes back once its slot has been freed
+    if (!player().isActive())
+    {
+        spawnPlayer();
+    }
+
+    scheduleLifespans();
+
+    // a small scene's tick is over in microseconds, quicker than waking the workers
+    if (m_entities.getEntities().size() < ParallelEntities) { m_scheduler.runInOrder(); }
+    else { m_scheduler.run(m_jobs); }
+
+    if (!m_paused)
+    {
+        m_currentFrame++;
+    }
+}
+
+// everything the last update added files its expiry with sLifespan's timer wheel
+void Game::scheduleLifespans()
+{
+    for (auto& e : m_entities.getAddedEntities())
+    {
+        if (!e.isActive() || !e.has<CLifespan>()) { continue; }
+
+        const auto& lifespan = e.get<CLifespan>();
+        m_lifespanTimers.schedule(lifespan.spawnFrame + lifespan.lifespan + 1, e.handle());
+    }
 }
 
 void Game::setPaused(bool paused)
@@ -137,122 +357,145 @@ void Game::setPaused(bool paused)
 // respawn the player in the middle of the screen
 void Game::spawnPlayer()
 {
+    TRACE_SCOPE("spawnPlayer");
     // We create every entity by calling EntityManager.addEntity(tag)
-    auto entity = m_entities.addEntity("player");
+    auto entity = m_entities.addEntity(Tag::Player);
+    m_player = entity.handle();
 
     // Give this entity a Transform so it spawns at (200,200) with velocity (1,1) and angle 0.0f
-    entity->add<CTransform>(Vec2f(m_window.getSize().x / 2, m_window.getSize().y / 2), Vec2f(0.0f, 0.0f), 0.0f);
+    entity.add<CTransform>(Vec2f(m_windowSize.x / 2, m_windowSize.y / 2), Vec2f(0.0f, 0.0f), 0.0f);
 
-    entity->add<CShape>(m_playerConfig.SR, m_playerConfig.V, sf::Color(m_playerConfig.FR, m_playerConfig.FG, m_playerConfig.FB), 
+    entity.add<CShape>(m_playerConfig.SR, m_playerConfig.V, sf::Color(m_playerConfig.FR, m_playerConfig.FG, m_playerConfig.FB), 
         sf::Color(m_playerConfig.OR, m_playerConfig.OG, m_playerConfig.OB), m_playerConfig.OT);
-    entity->get<CShape>().circle.setOrigin(m_playerConfig.SR, m_playerConfig.SR);
 
     // Add an input component to the player so that we can use inputs
-    entity->add<CInput>();
-
-    // Add special move
-    // Cooldown in frames = cooldown in min * 60 * fps 
-    entity->add<CSpecial>(1*60*60);
-    entity->get<CSpecial>().text = sf::Text("Special Move Available!", m_font, 24);
-    entity->get<CSpecial>().text.setFillColor(sf::Color(255, 255, 255));
-    entity->get<CSpecial>().text.setPosition(200.0f, 0.0f);
+    entity.add<CInput>();
+
+    entity.add<CCollision>((float)m_playerConfig.CR, Layer::Player, m_layerMasks[Layer::index(Layer::Player)]);
+
+    // Reset the special move, there is only one so it lives in the manager's resources
+    // Cooldown in ticks = cooldown in min * 60 * ticks per second
+    // and drop the last player's cooldown so it can't make the fresh special available early
+    auto& special = m_entities.resource<CSpecial>();
+    special.reset(1*60*60);
+    m_cooldownTimers.cancel(m_cooldownTimer);
+    special.text.setFont(m_font);
+    special.text.setCharacterSize(24);
+    special.text.setString(SpecialAvailableText);
+    special.text.setFillColor(sf::Color(255, 255, 255));
+    special.text.setPosition(200.0f, 0.0f);
 }
 
 // spawn an enemy at a random position
 void Game::spawnEnemy()
 {
+    TRACE_SCOPE("spawnEnemy");
     // the enemy must be spawned completely within the bounds of the window
     int vertices = m_verticesDist(m_randomGen);
     // speed between min and max
     float speed = m_speedDist(m_randomGen);
     // random angle between [0, 2pi] for direction
     float theta = m_angleDist(m_randomGen);
-    float speedX = speed * std::cos(theta);
-    float speedY = speed * std::sin(theta);
+    Vec2f velocity = Vec2f::polar(theta, speed);
 
-    auto entity = m_entities.addEntity("enemy");
-    entity->add<CTransform>(Vec2f(m_xDist(m_randomGen), m_yDist(m_randomGen)), Vec2f(speedX, speedY), 0.0f);
-    entity->add<CShape>(m_enemyConfig.SR, vertices,
-        sf::Color(m_colorDist(m_randomGen), m_colorDist(m_randomGen), m_colorDist(m_randomGen)),
+    // recorded now, the enemy appears at the next EntityManager::update()
+    auto& commands = m_entities.commands();
+    auto entity = commands.create(Tag::Enemy);
+    Vec2f pos(m_xDist(m_randomGen), m_yDist(m_randomGen));
+    commands.add<CTransform>(entity, pos, velocity, 0.0f);
+    sf::Color fill(m_colorDist(m_randomGen), m_colorDist(m_randomGen), m_colorDist(m_randomGen));
+    commands.add<CShape>(entity, m_enemyConfig.SR, vertices, fill,
         sf::Color(m_enemyConfig.OR, m_enemyConfig.OG, m_enemyConfig.OB), m_enemyConfig.OT);
-    entity->get<CShape>().circle.setOrigin(m_enemyConfig.SR, m_enemyConfig.SR);
-    entity->add<CScore>(vertices * 100);
+    commands.add<CScore>(entity, vertices * 100);
+    commands.add<CCollision>(entity, (float)m_enemyConfig.CR, Layer::Enemy, m_layerMasks[Layer::index(Layer::Enemy)]);
 }
 
 // spawns the small enemies when a big one (input entity e) explodes
-void Game::spawnSmallEnemies(std::shared_ptr<Entity> e)
+void Game::spawnSmallEnemies(Entity e)
 {
+    TRACE_SCOPE("spawnSmallEnemies");
     // - spawn a number of small enemies equal to the vertices of the original enemy
     // - set each small enemy to the same color as the original, half the size
     // - small enemies are worth double points of the original enemy
-    int vertices = (int)e->get<CShape>().circle.getPointCount();
+    auto& commands = m_entities.commands();
+    int vertices = (int)e.get<CShape>().points;
     float theta =  m_angleDist(m_randomGen);
     for (int i = 0; i < vertices; i++)
     {
         
-        auto entity = m_entities.addEntity("smallEnemy");
-        entity->add<CTransform>(e->get<CTransform>().pos, 
-            Vec2f(std::cos(theta + 2.0f * 3.141592f / vertices * i), std::sin(theta + 2.0f * 3.141592f / vertices * i)) 
-            * e->get<CTransform>().velocity.length(),
+        auto entity = commands.create(Tag::SmallEnemy);
+        commands.add<CTransform>(entity, e.get<CTransform>().pos,
+            Vec2f::polar(theta + 2.0f * 3.141592f / vertices * i, e.get<CTransform>().velocity.length()),
             0.0f);
-        entity->add<CShape>(m_enemyConfig.SR / 2, vertices,
-            e->get<CShape>().circle.getFillColor(),
-            e->get<CShape>().circle.getOutlineColor(), m_enemyConfig.OT);
-        entity->get<CShape>().circle.setOrigin(m_enemyConfig.SR / 2.0f, m_enemyConfig.SR / 2.0f);
-        entity->add<CScore>(vertices * 200);
-        entity->add<CLifespan>(m_enemyConfig.L);
+        commands.add<CShape>(entity, m_enemyConfig.SR / 2, vertices,
+            e.get<CShape>().fillColor(),
+            e.get<CShape>().outlineColor(), m_enemyConfig.OT);
+        commands.add<CScore>(entity, vertices * 200);
+        commands.add<CLifespan>(entity, m_enemyConfig.L, m_currentFrame);
+        commands.add<CCollision>(entity, (float)(m_enemyConfig.CR / 2), Layer::SmallEnemy,
+            m_layerMasks[Layer::index(Layer::SmallEnemy)]);
     }
 }
 
 // spawns a bullet from a given entity to a target location
-void Game::spawnBullet(std::shared_ptr<Entity> entity, const Vec2f& target)
+void Game::spawnBullet(Entity entity, const Vec2f& target)
 {
-    Vec2f entityPos = entity->get<CTransform>().pos;
-    Vec2f bulletSpeed = (target - entityPos) / target.dist(entityPos) * m_bulletConfig.S;
+    TRACE_SCOPE("spawnBullet");
+    Vec2f entityPos = entity.get<CTransform>().pos;
+    Vec2f bulletSpeed = (target - entityPos).normalized() * m_bulletConfig.S;
 
-    auto bullet = m_entities.addEntity("bullet");
-    bullet->add<CTransform>(entityPos, bulletSpeed, 0.0f);
-    bullet->add<CShape>(m_bulletConfig.SR, m_bulletConfig.V, sf::Color(m_bulletConfig.FR, m_bulletConfig.FG, m_bulletConfig.FB),
+    auto& commands = m_entities.commands();
+    auto bullet = commands.create(Tag::Bullet);
+    commands.add<CTransform>(bullet, entityPos, bulletSpeed, 0.0f);
+    commands.add<CShape>(bullet, m_bulletConfig.SR, m_bulletConfig.V, sf::Color(m_bulletConfig.FR, m_bulletConfig.FG, m_bulletConfig.FB),
         sf::Color(m_bulletConfig.OR, m_bulletConfig.OG, m_bulletConfig.OB), m_bulletConfig.OT);
-    bullet->get<CShape>().circle.setOrigin(m_bulletConfig.SR, m_bulletConfig.SR);
-    bullet->add<CLifespan>(m_bulletConfig.L);
+    commands.add<CLifespan>(bullet, m_bulletConfig.L, m_currentFrame);
+    // bullets move more than their own size in a tick, so they are tested along their path
+    commands.add<CCollision>(bullet, (float)m_bulletConfig.CR, Layer::Shot, m_layerMasks[Layer::index(Layer::Shot)], true);
 }
 
 // spawns a small ally that orbits the player (input entity e) and randomly shoots bullets
-void Game::spawnSpecialWeapon(std::shared_ptr<Entity> e)
+void Game::spawnSpecialWeapon(Entity e)
 {
+    TRACE_SCOPE("spawnSpecialWeapon");
     // - spawn a number of small allies equal to the vertices of the player
     // - the allies start at the center of the player and move outwards until 3 x radius of the player
     // - then start spinning around the player shooting bullets at random directions
-    if (e->has<CSpecial>() && e->get<CSpecial>().available)
+    // - a player killed last tick is only replaced after the next update, allies
+    //   it fired now would miss sCollisionResponse's cleanup and join the new one
+    auto& special = m_entities.resource<CSpecial>();
+    if (special.available && e.isActive())
     {
-        int vertices = (int)e->get<CShape>().circle.getPointCount();
+        auto& commands = m_entities.commands();
+        int vertices = (int)e.get<CShape>().points;
         float theta = m_angleDist(m_randomGen);
         for (int i = 0; i < vertices; i++)
         {
 
-            auto entity = m_entities.addEntity("smallAlly");
-            entity->add<CTransform>(e->get<CTransform>().pos,
-                Vec2f(std::cos(theta + 2.0f * 3.141592f / vertices * i), std::sin(theta + 2.0f * 3.141592f / vertices * i))
-                * m_playerConfig.S,
+            auto entity = commands.create(Tag::SmallAlly);
+            commands.add<CTransform>(entity, e.get<CTransform>().pos,
+                Vec2f::polar(theta + 2.0f * 3.141592f / vertices * i, m_playerConfig.S),
                 0.0f);
-            entity->add<CShape>(m_playerConfig.SR / 2, vertices,
-                e->get<CShape>().circle.getFillColor(),
-                e->get<CShape>().circle.getOutlineColor(), m_playerConfig.OT);
-            entity->get<CShape>().circle.setOrigin(m_playerConfig.SR / 2.0f, m_playerConfig.SR / 2.0f);
+            commands.add<CShape>(entity, m_playerConfig.SR / 2, vertices,
+                e.get<CShape>().fillColor(),
+                e.get<CShape>().outlineColor(), m_playerConfig.OT);
+            commands.add<CCollision>(entity, (float)(m_playerConfig.CR / 2), Layer::Shot,
+                m_layerMasks[Layer::index(Layer::Shot)]);
         }
-        e->get<CSpecial>().lastfired = m_currentFrame;
-        e->get<CSpecial>().available = false;
-        e->get<CSpecial>().text.setString("Special Move on Cooldown!");
+        special.lastfired = m_currentFrame;
+        special.available = false;
+        special.text.setString(SpecialCooldownText);
+        m_cooldownTimer = m_cooldownTimers.schedule(m_currentFrame + special.cooldown + 1, m_currentFrame);
     }
 }
 
 void Game::sMovement()
 {
-    auto& playerTransform = player()->get<CTransform>();
+    TRACE_SCOPE("sMovement");
+    auto playerTransform = player().get<CTransform>();
     // handle player movement
     Vec2f tempVel = Vec2f(0.0f, 0.0f);
-    auto& playerInput = player()->get<CInput>();
+    auto& playerInput = player().get<CInput>();
     if (playerInput.up) { tempVel.y += -1.0f; }
     if (playerInput.down) { tempVel.y += 1.0f; }
     if (playerInput.left) { tempVel.x += -1.0f; }
@@ -264,202 +507,252 @@ void Game::sMovement()
     }
     else
     {
-        playerTransform.velocity = tempVel / tempVel.length() * m_playerConfig.S;
+        playerTransform.velocity = tempVel.normalized() * m_playerConfig.S;
+    }
+
+    // integrate every slot in parallel chunks, the arrays are contiguous and no slot reads another
+    auto& transforms = m_entities.getComponents<CTransform>();
+    Vec2f* positions = transforms.positions().data();
+    Vec2f* velocities = transforms.velocities().data();
+    float* angles = transforms.angles().data();
+
+    m_jobs.parallelFor(m_entities.size(), 8192, [=](size_t begin, size_t end)
+    {
+        Kernels::integrate(positions, velocities, angles, begin, end, 1.0f);
+    });
+
+    // special small Ally movement properties, after everything (the player included) has moved
+    m_allyIds.clear();
+    m_allyPositions.clear();
+    for (auto& e : m_entities.getEntities(Tag::SmallAlly))
+    {
+        if (!e.isActive()) { continue; }
+        m_allyIds.push_back((uint32_t)e.id());
+        m_allyPositions.push_back(positions[e.id()]);
     }
+    m_allyDistances.resize(m_allyIds.size());
+    m_allyPositions.distSquared(playerTransform.pos, m_allyDistances.data());
 
-    for (auto& e : m_entities.getEntities())
+    // once they are at 4x distance from player they stop moving outwards and circle it
+    float orbit = 3.9f * m_playerConfig.SR;
+    m_orbitIds.clear();
+    m_orbitDirections.clear();
+    for (size_t i = 0; i < m_allyIds.size(); i++)
     {
-        auto& transform = e->get<CTransform>();
-        transform.pos += transform.velocity;
-        
-        // special small Ally movement properties
-        if (e->tag() == "smallAlly")
-        {
-            // once they are at 4x distance from player they stop moving outwards
-            if (transform.pos.dist(playerTransform.pos) >= 3.9f * m_playerConfig.SR)
-            {
-                transform.velocity = Vec2f(0.0f, 0.0f);
-                float currentAngle = std::atan2(transform.pos.y - playerTransform.pos.y, transform.pos.x - playerTransform.pos.x);
-                transform.pos = playerTransform.pos + Vec2f(std::cos(currentAngle + 0.02f), std::sin(currentAngle + 0.02f)) * 4.2f * m_playerConfig.SR;
-            }
-            // they move with the player
-            transform.pos += playerTransform.velocity;
-        }
-        e->get<CShape>().circle.setPosition(transform.pos);
-        transform.angle += 1.0f;
-        e->get<CShape>().circle.setRotation(transform.angle);
+        if (m_allyDistances[i] < orbit * orbit) { continue; }
+        m_orbitIds.push_back(m_allyIds[i]);
+        m_orbitDirections.push_back(m_allyPositions[i] - playerTransform.pos);
+        velocities[m_allyIds[i]] = Vec2f(0.0f, 0.0f);
+    }
+    m_orbitDirections.normalizeAll();
+    m_orbitDirections.rotateAll(0.02f);
+    for (size_t i = 0; i < m_orbitIds.size(); i++)
+    {
+        positions[m_orbitIds[i]] = playerTransform.pos + m_orbitDirections[i] * 4.2f * m_playerConfig.SR;
+    }
+
+    // they move with the player
+    for (uint32_t id : m_allyIds)
+    {
+        positions[id] += playerTransform.velocity;
     }
 }
 
 void Game::sLifespan()
 {
-    // for all entities
-    //       if entity has no lifespan component, skip it
-    //       if entity has > 0 remaining lifespan, substract 1
-    //       if it has lifespan and is alive
-    //          scale its alpha channel properly
-    //       if it has lifespan and its time is up
-    //          destroy the entity
-    for (auto& e : m_entities.getEntities())
-    {
-        if (e->has<CLifespan>())
-        {
-            int& currentLifespan = e->get<CLifespan>().remaining;
-            sf::Color currentFillColor = e->get<CShape>().circle.getFillColor();
-            sf::Color currentOutlineColor = e->get<CShape>().circle.getOutlineColor();
-            if (currentLifespan > 0)
-            {
-                currentLifespan -= 1;
-                e->get<CShape>().circle.setFillColor(sf::Color(currentFillColor.r, currentFillColor.g, currentFillColor.b,
-                    (float)currentLifespan / (float)e->get<CLifespan>().lifespan * 255));
-                e->get<CShape>().circle.setOutlineColor(sf::Color(currentOutlineColor.r, currentOutlineColor.g, currentOutlineColor.b,
-                    (float)currentLifespan / (float)e->get<CLifespan>().lifespan * 255));
-            }
-            else
-            {
-                e->destroy();
-            }
-        }
-    }
+    TRACE_SCOPE("sLifespan");
+    // every entity with a lifespan filed its expiry frame in the wheel when it
+    // spawned, so only the timers due this frame are visited. The timer of an
+    // entity that already died carries a stale handle and destroy() ignores it
+    m_lifespanTimers.advance(m_currentFrame, [this](EntityHandle handle)
+    {
+        m_entities.destroy(handle);
+    });
 }
 
 void Game::sCollision()
 {
-    auto& playerPos = player()->get<CTransform>().pos;
-    auto& playerVel = player()->get<CTransform>().velocity;
-    int wWidth = m_window.getSize().x;
-    int wHeight = m_window.getSize().y;
+    TRACE_SCOPE("sCollision");
+    Entity p = player();
+    int wWidth = m_windowSize.x;
+    int wHeight = m_windowSize.y;
 
-    // enemies will bounce on walls, destroy the player and get killed by bullets
-    for (auto& e : m_entities.getEntities("enemy"))
+    // broadphase: every collidable on a layer some mask looks for goes into
+    // the grid, and the ones with a mask are the ones that will query it. A
+    // swept entity goes in as the circle around the whole path it took this
+    // tick, so the grid finds it wherever along that path it was
     {
-        auto& enemyPos = e->get<CTransform>().pos;
-        // bounce on walls
-        if ((enemyPos.x + m_enemyConfig.CR) > wWidth || (enemyPos.x - m_enemyConfig.CR) < 0)
-        {
-            e->get<CTransform>().velocity.x *= -1;
-        }
-        else if ((enemyPos.y + m_enemyConfig.CR) > wHeight || (enemyPos.y - m_enemyConfig.CR) < 0)
-        {
-            e->get<CTransform>().velocity.y *= -1;
-        }
-        
-        // collide with player
-        Vec2f distFromPlayer = playerPos - enemyPos;
-        if ((distFromPlayer.x * distFromPlayer.x + distFromPlayer.y * distFromPlayer.y) < 
-            ((m_playerConfig.CR + m_enemyConfig.CR) * (m_playerConfig.CR + m_enemyConfig.CR)))
-        {
-            player()->destroy();
-            for (auto& s : m_entities.getEntities("smallAlly"))
-            {
-                s->destroy();
-            }
-            m_score = 0;
-            m_text.setString("Score: " + std::to_string(m_score));
-            e->destroy();
-            spawnPlayer();
-        }
+        auto timer = m_profiler.time("sCollision/grid build");
+        uint32_t targets = 0;
+        for (uint32_t mask : m_layerMasks) { targets |= mask; }
+        const Vec2f* previous = m_entities.getComponents<CTransform>().prevPositions().data();
 
-        // collide with bullets
-        for (auto& b : m_entities.getEntities("bullet"))
+        m_collisionGrid.clear();
+        m_colliders.clear();
+        for (auto [e, transform, collision] : m_entities.view<CTransform, CCollision>())
         {
-            Vec2f distFromBullet = b->get<CTransform>().pos - enemyPos;
-            if ((distFromBullet.x * distFromBullet.x + distFromBullet.y * distFromBullet.y) <
-                ((m_enemyConfig.CR + m_bulletConfig.CR) * (m_enemyConfig.CR + m_bulletConfig.CR)))
+            if (collision.layer & targets)
             {
-                b->destroy();
-                spawnSmallEnemies(e);
-                m_score += e->get<CScore>().score;
-                m_text.setString("Score: " + std::to_string(m_score));
-                e->destroy();
-                break;
+                Vec2f from = collision.swept ? previous[e.id()] : transform.pos;
+                m_collisionGrid.insert(e, (from + transform.pos) * 0.5f,
+                    collision.radius + from.dist(transform.pos) * 0.5f, collision.layer);
             }
+            if (collision.mask) { m_colliders.push_back(e); }
         }
+        m_collisionGrid.build();
+    }
 
-        // collide with small Allies
-        for (auto& s : m_entities.getEntities("smallAlly"))
+    // enemies bounce on walls, a bounce only touches the enemy's own velocity so
+    // they can all be done up front in one pass over the transform arrays
+    {
+        auto timer = m_profiler.time("sCollision/bounce");
+        auto& transforms = m_entities.getComponents<CTransform>();
+        const Vec2f* positions = transforms.positions().data();
+        Vec2f* velocities = transforms.velocities().data();
+        const TagId* tags = m_entities.tags().data();
+        float radius = (float)m_enemyConfig.CR;
+
+        m_jobs.parallelFor(m_entities.size(), 8192, [=](size_t begin, size_t end)
         {
-            Vec2f distFromSmallAlly = s->get<CTransform>().pos - enemyPos;
-            if ((distFromSmallAlly.x * distFromSmallAlly.x + distFromSmallAlly.y * distFromSmallAlly.y) <
-                ((m_enemyConfig.CR + m_playerConfig.CR / 2) * (m_enemyConfig.CR + m_playerConfig.CR / 2)))
-            {
-                s->destroy();
-                spawnSmallEnemies(e);
-                m_score += e->get<CScore>().score;
-                m_text.setString("Score: " + std::to_string(m_score));
-                e->destroy();
-                break;
+            Kernels::bounce(positions, velocities, tags, Tag::Enemy, radius, (float)wWidth, (float)wHeight, begin, end);
+        });
+    }
 
-            }
-        }
+    // narrowphase: every collider against the grid. Nothing is destroyed here,
+    // each overlap becomes a contact for sCollisionResponse, so colliders can be
+    // checked in parallel
+    {
+        auto timer = m_profiler.time("sCollision/contacts");
+        findContacts();
     }
 
-    // same for small enemies except they dont bounce on walls or spawn more enemies
-    for (auto& e : m_entities.getEntities("smallEnemy"))
+    // player collide with walls, the transform view points into the component
+    // arrays, which spawns only grow in update(), so this moves the player itself
+    auto playerTransform = p.get<CTransform>();
+    if ((playerTransform.pos.x + m_playerConfig.CR) > wWidth || (playerTransform.pos.x - m_playerConfig.CR) < 0)
     {
-        auto& enemyPos = e->get<CTransform>().pos;
-        
-        // collide with player
-        Vec2f distFromPlayer = playerPos - enemyPos;
-        if ((distFromPlayer.x * distFromPlayer.x + distFromPlayer.y * distFromPlayer.y) <
-            ((m_playerConfig.CR + m_enemyConfig.CR / 2) * (m_playerConfig.CR + m_enemyConfig.CR / 2)))
-        {
-            player()->destroy();
-            for (auto& s : m_entities.getEntities("smallAlly"))
-            {
-                s->destroy();
-            }
-            m_score = 0;
-            m_text.setString("Score: " + std::to_string(m_score));
-            e->destroy();
-            spawnPlayer();
-        }
+        playerTransform.pos.x -= playerTransform.velocity.x;
+    }
 
-        // collide with bullets
-        for (auto& b : m_entities.getEntities("bullet"))
-        {
-            Vec2f distFromBullet = b->get<CTransform>().pos - enemyPos;
-            if ((distFromBullet.x * distFromBullet.x + distFromBullet.y * distFromBullet.y) <
-                ((m_enemyConfig.CR / 2 + m_bulletConfig.CR) * (m_enemyConfig.CR / 2 + m_bulletConfig.CR)))
-            {
-                b->destroy();
-                m_score += e->get<CScore>().score;
-                m_text.setString("Score: " + std::to_string(m_score));
-                e->destroy();
-                break;
-            }
-        }
+    if ((playerTransform.pos.y + m_playerConfig.CR) > wHeight || (playerTransform.pos.y - m_playerConfig.CR) < 0)
+    {
+        playerTransform.pos.y -= playerTransform.velocity.y;
+    }
+}
+
+// fills m_contacts with every overlap a collider's mask asks for, in collider
+// order and then query order whatever the thread count: each chunk of
+// colliders fills its own list and the lists are joined in chunk order
+void Game::findContacts()
+{
+    m_contacts.clear();
+    size_t chunks = std::min(m_jobs.threadCount() * 4, (m_colliders.size() + 255) / 256);
+    if (chunks == 0) { return; }
+    size_t chunkSize = (m_colliders.size() + chunks - 1) / chunks;
+    if (m_contactChunks.size() < chunks) { m_contactChunks.resize(chunks); }
+    auto& transforms = m_entities.getComponents<CTransform>();
+    const Vec2f* positions = transforms.positions().data();
+    const Vec2f* previous = transforms.prevPositions().data();
 
-        // collide with small Allies
-        for (auto& s : m_entities.getEntities("smallAlly"))
+    m_jobs.parallelFor(chunks, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; c++)
         {
-            Vec2f distFromSmallAlly = s->get<CTransform>().pos - enemyPos;
-            if ((distFromSmallAlly.x * distFromSmallAlly.x + distFromSmallAlly.y * distFromSmallAlly.y) <
-                ((m_enemyConfig.CR / 2 + m_playerConfig.CR / 2) * (m_enemyConfig.CR / 2 + m_playerConfig.CR / 2)))
+            auto& contacts = m_contactChunks[c];
+            contacts.clear();
+
+            size_t last = std::min(m_colliders.size(), (c + 1) * chunkSize);
+            for (size_t i = c * chunkSize; i < last; i++)
             {
-                s->destroy();
-                m_score += e->get<CScore>().score;
-                m_text.setString("Score: " + std::to_string(m_score));
-                e->destroy();
-                break;
+                const Entity& e = m_colliders[i];
+                if (!e.isActive()) { continue; }
+
+                const CCollision& collision = e.get<CCollision>();
+                const ContactKind* kinds = m_contactKinds[Layer::index(collision.layer)];
+
+                // the grid is asked about the circle around this tick's path, which
+                // covers both where the collider is now and anything it swept through
+                Vec2f from = previous[e.id()], to = positions[e.id()];
+                m_collisionGrid.query((from + to) * 0.5f, collision.radius + from.dist(to) * 0.5f, [&](const SpatialHash::Item& item)
+                {
+                    // anything that died before this frame's collisions is no longer there to hit
+                    if (!(collision.mask & item.layer) || !item.entity.isActive()) { return false; }
+
+                    // two swept paths are tested for their closest approach, anything else where it is now
+                    const CCollision& other = item.entity.get<CCollision>();
+                    size_t id = item.entity.id();
+                    float r = collision.radius + other.radius;
+                    bool hit = (collision.swept || other.swept)
+                        ? sweptOverlap(from, to, previous[id], positions[id], r)
+                        : positions[id].distSquared(to) < r * r;
+                    if (hit)
+                    {
+                        contacts.push_back({ e, item.entity, kinds[Layer::index(item.layer)] });
+                    }
+                    return false;
+                });
             }
         }
-    }
+    });
 
-    // player collide with walls
-    if ((playerPos.x + m_playerConfig.CR) > wWidth || (playerPos.x - m_playerConfig.CR) < 0)
+    for (size_t c = 0; c < chunks; c++)
     {
-        playerPos.x -= playerVel.x;
+        m_contacts.insert(m_contacts.end(), m_contactChunks[c].begin(), m_contactChunks[c].end());
     }
+}
 
-    if ((playerPos.y + m_playerConfig.CR) > wHeight || (playerPos.y - m_playerConfig.CR) < 0)
+void Game::sCollisionResponse()
+{
+    TRACE_SCOPE("sCollisionResponse");
+    // An enemy dies on its first contact with something still alive, so any
+    // later contacts of the same enemy, or with whatever it took down, are
+    // skipped. Walking the contacts in order gives the same outcome as
+    // resolving each overlap the moment it was found
+    std::fill(std::begin(m_contactsFound), std::end(m_contactsFound), 0);
+    std::fill(std::begin(m_contactsResolved), std::end(m_contactsResolved), 0);
+    for (auto& contact : m_contacts)
     {
-        playerPos.y -= playerVel.y;
+        m_contactsFound[(size_t)contact.kind]++;
+        if (!contact.a.isActive() || !contact.b.isActive()) { continue; }
+        m_contactsResolved[(size_t)contact.kind]++;
+
+        switch (contact.kind)
+        {
+        case ContactKind::None:
+            break;
+
+        // enemies will destroy the player
+        case ContactKind::EnemyPlayer:
+        case ContactKind::SmallEnemyPlayer:
+            contact.b.destroy();
+            for (auto& s : m_entities.getEntities(Tag::SmallAlly))
+            {
+                s.destroy();
+            }
+            m_score = 0;
+            contact.a.destroy();
+            break;
+
+        // and get killed by bullets and small Allies, big ones break up into small ones
+        case ContactKind::EnemyShot:
+            contact.b.destroy();
+            spawnSmallEnemies(contact.a);
+            m_score += contact.a.get<CScore>().score;
+            contact.a.destroy();
+            break;
+
+        case ContactKind::SmallEnemyShot:
+            contact.b.destroy();
+            m_score += contact.a.get<CScore>().score;
+            contact.a.destroy();
+            break;
+        }
     }
 }
 
 void Game::sEnemySpawner()
 {
+    TRACE_SCOPE("sEnemySpawner");
     if ((m_currentFrame - m_lastEnemySpawnTime) > m_enemyConfig.SP)
     {
         spawnEnemy();
@@ -471,14 +764,22 @@ void Game::sEnemySpawner()
 
 void Game::sSmallAllyBulletSpawner()
 {
+    TRACE_SCOPE("sSmallAllyBulletSpawner");
     
-    if (m_random(m_randomGen) > 0.98f)
+    const auto& allies = m_entities.getEntities(Tag::SmallAlly);
+    if (m_random(m_randomGen) > 0.98f && !allies.empty())
     {
-        for (auto& s : m_entities.getEntities("smallAlly"))
+        m_enemyIndex.refresh(m_entities, m_currentFrame);
+        for (auto& s : allies)
         {
             if (m_random(m_randomGen) > 0.5f)
             {
-                spawnBullet(s, Vec2f(m_xDist(m_randomGen), m_yDist(m_randomGen)));
+                // aim at the nearest enemy, or anywhere if there are none
+                m_enemyIndex.kNearest(s.get<CTransform>().pos, 1, { Tag::Enemy, Tag::SmallEnemy }, m_nearestEnemies);
+                Vec2f target = m_nearestEnemies.empty()
+                    ? Vec2f(m_xDist(m_randomGen), m_yDist(m_randomGen))
+                    : m_nearestEnemies[0].get<CTransform>().pos;
+                spawnBullet(s, target);
             }
         }
     }
@@ -487,18 +788,19 @@ void Game::sSmallAllyBulletSpawner()
 
 void Game::sCooldown()
 {
-    if (player()->has<CSpecial>() && !player()->get<CSpecial>().available)
+    TRACE_SCOPE("sCooldown");
+    // a respawn cancels the pending cooldown, so whatever fires here is the current player's
+    m_cooldownTimers.advance(m_currentFrame, [this](int)
     {
-        if (m_currentFrame - player()->get<CSpecial>().lastfired > player()->get<CSpecial>().cooldown)
-        {
-            player()->get<CSpecial>().available = true;
-            player()->get<CSpecial>().text.setString("Special Move Available!");
-        }
-    }
+        auto& special = m_entities.resource<CSpecial>();
+        special.available = true;
+        special.text.setString(SpecialAvailableText);
+    });
 }
 
 void Game::sGUI()
 {
+    TRACE_SCOPE("sGUI");
     ImGui::Begin("Geometry Wars");
     if (ImGui::BeginTabBar("MyTabBar"))
     {
@@ -522,19 +824,21 @@ void Game::sGUI()
         {
             if (ImGui::CollapsingHeader("Entities by Tag"))
             {
-                for (auto& [tag, entityVec] : m_entities.getEntityMap())
+                for (TagId tag = 0; tag < m_entities.getEntityMap().size(); tag++)
                 {
-                    if (ImGui::CollapsingHeader(tag.c_str()))
+                    auto& entityVec = m_entities.getEntityMap()[tag];
+                    const std::string& tagName = m_entities.tagName(tag);
+                    if (ImGui::CollapsingHeader(tagName.c_str()))
                     {
                         if (ImGui::BeginTable("", 4))
                         {
                             for (auto& e : entityVec)
                             {
-                                std::string id = std::to_string(e->id());
-                                Vec2f position = e->get<CTransform>().pos;
+                                std::string id = std::to_string(e.id());
+                                Vec2f position = e.get<CTransform>().pos;
                                 ImGui::TableNextRow();
                                 ImGui::TableSetColumnIndex(0);
-                                sf::Color eColor = e->get<CShape>().circle.getFillColor();
+                                sf::Color eColor = e.get<CShape>().fillColor();
                                 ImVec4 imguiColor(
                                     static_cast<float>(eColor.r) / 255.0f, // Red
                                     static_cast<float>(eColor.g) / 255.0f, // Green
@@ -545,13 +849,13 @@ void Game::sGUI()
                                 ImGui::PushStyleColor(ImGuiCol_Button, imguiColor);
                                 if (ImGui::Button(("D##" + id).c_str()))
                                 {
-                                    e->destroy();
+                                    e.destroy();
                                 }
                                 ImGui::PopStyleColor(1);
                                 ImGui::TableSetColumnIndex(1);
                                 ImGui::TextUnformatted(id.c_str());
                                 ImGui::TableSetColumnIndex(2);
-                                ImGui::TextUnformatted(tag.c_str());
+                                ImGui::TextUnformatted(tagName.c_str());
                                 ImGui::TableSetColumnIndex(3);
                                 ImGui::TextUnformatted(("(" + std::to_string((int)position.x) + "," + std::to_string((int)position.y) + ")").c_str());
                                 
@@ -568,11 +872,11 @@ void Game::sGUI()
                 {
                     for (auto& e : m_entities.getEntities())
                     {
-                        std::string id = std::to_string(e->id());
-                        Vec2f position = e->get<CTransform>().pos;
+                        std::string id = std::to_string(e.id());
+                        Vec2f position = e.get<CTransform>().pos;
                         ImGui::TableNextRow();
                         ImGui::TableSetColumnIndex(0);
-                        sf::Color eColor = e->get<CShape>().circle.getFillColor();
+                        sf::Color eColor = e.get<CShape>().fillColor();
                         ImVec4 imguiColor(
                             static_cast<float>(eColor.r) / 255.0f, // Red
                             static_cast<float>(eColor.g) / 255.0f, // Green
@@ -583,13 +887,13 @@ void Game::sGUI()
                         ImGui::PushStyleColor(ImGuiCol_Button, imguiColor);
                         if (ImGui::Button(("D##" + id).c_str()))
                         {
-                            e->destroy();
+                            e.destroy();
                         }
                         ImGui::PopStyleColor(1);
                         ImGui::TableSetColumnIndex(1);
                         ImGui::TextUnformatted(id.c_str());
                         ImGui::TableSetColumnIndex(2);
-                        ImGui::TextUnformatted(e->tag().c_str());
+                        ImGui::TextUnformatted(m_entities.tagName(e.tag()).c_str());
                         ImGui::TableSetColumnIndex(3);
                         ImGui::TextUnformatted(("(" + std::to_string((int)position.x) + "," + std::to_string((int)position.y) + ")").c_str());
 
@@ -599,6 +903,113 @@ void Game::sGUI()
             }
             ImGui::EndTabItem();
         }
+
+        if (ImGui::BeginTabItem("Profiler"))
+        {
+            auto& sections = m_profiler.sections();
+
+            ImGui::Text("Simulation threads: %d", (int)m_jobs.threadCount());
+            ImGui::Text("Heap allocations last frame: %d, after warm-up: %d",
+                (int)m_frameAllocations, (int)m_steadyAllocations);
+            if (ImGui::TreeNode("System dependencies"))
+            {
+                for (size_t i = 0; i < m_scheduler.size(); i++)
+                {
+                    std::string after;
+                    for (auto& name : m_scheduler.dependencies(i)) { after += (after.empty() ? "" : ", ") + name; }
+                    ImGui::Text("%s after: %s", m_scheduler.name(i).c_str(), after.empty() ? "-" : after.c_str());
+                }
+                ImGui::TreePop();
+            }
+
+            if (ImGui::TreeNode("Contacts last tick"))
+            {
+                if (ImGui::BeginTable("Contacts", 3))
+                {
+                    ImGui::TableSetupColumn("Kind");
+                    ImGui::TableSetupColumn("found");
+                    ImGui::TableSetupColumn("resolved");
+                    ImGui::TableHeadersRow();
+                    for (size_t kind = 1; kind < ContactKinds; kind++)
+                    {
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::TextUnformatted(ContactKindNames[kind]);
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%d", m_contactsFound[kind]);
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::Text("%d", m_contactsResolved[kind]);
+                    }
+                    ImGui::EndTable();
+                }
+                ImGui::TreePop();
+            }
+
+            if (ImGui::BeginTable("Profiler", 4))
+            {
+                ImGui::TableSetupColumn("System");
+                ImGui::TableSetupColumn("avg ms");
+                ImGui::TableSetupColumn("p99 ms");
+                ImGui::TableSetupColumn("last ms");
+                ImGui::TableHeadersRow();
+                for (auto& section : sections)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(((section.nested ? "  " : "") + section.name).c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%.3f", m_profiler.average(section));
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.3f", m_profiler.percentile(section, 0.99f));
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.3f", m_profiler.frames() ? m_profiler.at(section, 0) : 0.0f);
+                }
+                ImGui::EndTable();
+            }
+
+            // stacked frame time graph, one column per frame and one band per top level system
+            size_t frames = m_profiler.frames();
+            float maxTotal = 1000.0f / 60.0f;
+            for (size_t age = 0; age < frames; age++)
+            {
+                float total = 0.0f;
+                for (auto& section : sections)
+                {
+                    if (!section.nested) { total += m_profiler.at(section, age); }
+                }
+                maxTotal = std::max(maxTotal, total);
+            }
+
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            ImVec2 size(ImGui::GetContentRegionAvail().x, 200.0f);
+            ImGui::Dummy(size);
+            ImDrawList* drawList = ImGui::GetWindowDrawList();
+            drawList->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(20, 20, 20, 255));
+
+            float columnWidth = size.x / Profiler::HistorySize;
+            float scale = size.y / maxTotal;
+            for (size_t age = 0; age < frames; age++)
+            {
+                float x = origin.x + size.x - (age + 1) * columnWidth;
+                float y = origin.y + size.y;
+                for (size_t i = 0; i < sections.size(); i++)
+                {
+                    if (sections[i].nested) { continue; }
+
+                    float h = m_profiler.at(sections[i], age) * scale;
+                    drawList->AddRectFilled(ImVec2(x, y - h), ImVec2(x + columnWidth, y), ImColor::HSV(i / (float)sections.size(), 0.6f, 0.9f));
+                    y -= h;
+                }
+            }
+            ImGui::Text("graph height: %.2f ms", maxTotal);
+
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                if (sections[i].nested) { continue; }
+                ImGui::TextColored(ImColor::HSV(i / (float)sections.size(), 0.6f, 0.9f), "%s", sections[i].name.c_str());
+            }
+            ImGui::EndTabItem();
+        }
     
         ImGui::EndTabBar();
     }
@@ -606,19 +1017,51 @@ void Game::sGUI()
     ImGui::End();
 }
 
-void Game::sRender()
+void Game::buildRenderBatch(float alpha)
 {
-    m_window.clear();
-    if (m_render)
+    TRACE_SCOPE("buildRenderBatch");
+
+    // build every shape straight from the component arrays so they go out in one draw call
+    // positions are blended between the last two ticks so motion stays smooth at any frame rate
+    auto& transforms = m_entities.getComponents<CTransform>();
+    float frame = (float)m_currentFrame - 1.0f + alpha;     // the frame the blended positions are from
+    m_batch.clear();
+    for (auto [e, transform, shape] : m_entities.view<CTransform, CShape>())
     {
-        for (auto& e : m_entities.getEntities())
+        const Vec2f& prevPos = transforms.prevPositions()[e.id()];
+        Vec2f pos = prevPos + (transform.pos - prevPos) * alpha;
+        float prevAngle = transforms.prevAngles()[e.id()];
+        float angle = prevAngle + (transform.angle - prevAngle) * alpha;
+
+        // entities with a lifespan fade out over it, worked out from when they spawned
+        sf::Color fill = shape.fillColor();
+        sf::Color outline = shape.outlineColor();
+        if (e.has<CLifespan>())
         {
-            m_window.draw(e->get<CShape>().circle);
+            fill.a = outline.a = e.get<CLifespan>().alpha(frame);
         }
+        m_batch.addPolygon(pos, angle, shape.radius, shape.points, fill, outline, shape.outlineThickness);
     }
+}
 
+void Game::sRender(float alpha)
+{
+    TRACE_SCOPE("sRender");
+    m_window.clear();
+    if (m_render)
+    {
+        buildRenderBatch(alpha);
+        m_batch.draw(m_window);
+    }
+
+    // the score text is only rebuilt on frames where the score changed, collisions just update m_score
+    if (m_hudScore != m_score)
+    {
+        m_hudScore = m_score;
+        m_text.setString("Score: " + std::to_string(m_score));
+    }
     m_window.draw(m_text);
-    m_window.draw(player()->get<CSpecial>().text);
+    m_window.draw(m_entities.resource<CSpecial>().text);
 
     // draw the ui last
     ImGui::SFML::Render(m_window);
@@ -626,8 +1069,27 @@ void Game::sRender()
     m_window.display();
 }
 
+void Game::sScriptedInput()
+{
+    TRACE_SCOPE("sScriptedInput");
+    while (m_nextScriptedInput < m_script.size() && m_script[m_nextScriptedInput].frame <= m_currentFrame)
+    {
+        const ScriptedInput& input = m_script[m_nextScriptedInput++];
+        auto& playerInput = player().get<CInput>();
+
+        if (input.action == "up") { playerInput.up = input.x != 0; }
+        else if (input.action == "down") { playerInput.down = input.x != 0; }
+        else if (input.action == "left") { playerInput.left = input.x != 0; }
+        else if (input.action == "right") { playerInput.right = input.x != 0; }
+        else if (input.action == "shoot") { spawnBullet(player(), Vec2f(input.x, input.y)); }
+        else if (input.action == "special") { spawnSpecialWeapon(player()); }
+        else if (input.action == "quit") { m_running = false; }
+    }
+}
+
 void Game::sUserInput()
 {
+    TRACE_SCOPE("sUserInput");
     sf::Event event;
     while (m_window.pollEvent(event))
     {
@@ -646,16 +1108,16 @@ void Game::sUserInput()
             switch (event.key.code)
             {
             case sf::Keyboard::W:
-                player()->get<CInput>().up = true;
+                player().get<CInput>().up = true;
                 break;
             case sf::Keyboard::A:
-                player()->get<CInput>().left = true;
+                player().get<CInput>().left = true;
                 break;
             case sf::Keyboard::S:
-                player()->get<CInput>().down = true;
+                player().get<CInput>().down = true;
                 break;
             case sf::Keyboard::D:
-                player()->get<CInput>().right = true;
+                player().get<CInput>().right = true;
                 break;
             case sf::Keyboard::Escape:
                 m_running = false;
@@ -675,16 +1137,16 @@ void Game::sUserInput()
             switch (event.key.code)
             {
             case sf::Keyboard::W:
-                player()->get<CInput>().up = false;
+                player().get<CInput>().up = false;
                 break;
             case sf::Keyboard::A:
-                player()->get<CInput>().left = false;
+                player().get<CInput>().left = false;
                 break;
             case sf::Keyboard::S:
-                player()->get<CInput>().down = false;
+                player().get<CInput>().down = false;
                 break;
             case sf::Keyboard::D:
-                player()->get<CInput>().right = false;
+                player().get<CInput>().right = false;
                 break;
             default: break;
             }
@@ -1,10 +1,23 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <bit>
+#include <optional>
 #include <random>
 #include "EntityManager.hpp"
+#include "BatchRenderer.hpp"
 #include "Entity.hpp"
+#include "HeapStats.hpp"
+#include "JobSystem.hpp"
+#include "Kernels.hpp"
+#include "Profiler.hpp"
+#include "SpatialHash.hpp"
+#include "SpatialIndex.hpp"
+#include "SystemScheduler.hpp"
+#include "TimerWheel.hpp"
+#include "Trace.hpp"
 #include "Vec2.hpp"
+#include "Vec2Array.hpp"
 #include "imgui.h"
 #include "imgui-SFML.h"
 
@@ -12,18 +25,95 @@ struct PlayerConfig { int SR, CR, FR, FG, FB, OR, OG, OB, OT, V; float S; };
 struct EnemyConfig  { int SR, CR, OR, OG, OB, OT, VMIN, VMAX, L, SP; float SMIN, SMAX; };
 struct BulletConfig { int SR, CR, FR, FG, FB, OR, OG, OB, OT, V, L; float S; };
 
+struct GameOptions
+{
+    std::string             config      = "config.txt";
+    std::string             inputScript;                // optional scripted input file, see ScriptedInput
+    std::optional<unsigned> seed;                       // fixed RNG seed, random if not set
+    int                     frames      = -1;           // stop after this many frames, -1 runs until quit
+    unsigned                threads     = 0;            // simulation threads including the main one, 0 uses every core
+    bool                    headless    = false;        // run the systems without a window, ImGui or fonts
+};
+
+// One line of a scripted input file, "<frame> <action> [args]":
+//   <frame> up|down|left|right 1|0     press or release a movement key
+//   <frame> shoot <x> <y>              fire a bullet at a point
+//   <frame> special                    fire the special weapon
+//   <frame> quit                       stop the game
+struct ScriptedInput { int frame = 0; std::string action; float x = 0, y = 0; };
+
+// Collision layers, one bit each, for CCollision::layer and CCollision::mask
+namespace Layer
+{
+    constexpr uint32_t  Player      = 1u << 0;
+    constexpr uint32_t  Enemy       = 1u << 1;
+    constexpr uint32_t  SmallEnemy  = 1u << 2;
+    constexpr uint32_t  Shot        = 1u << 3;      // bullets and small allies
+    constexpr int       Count       = 4;
+
+    constexpr int index(uint32_t layer) { return std::countr_zero(layer); }
+}
+
+// An overlap sCollision found, for sCollisionResponse to act on. a is the
+// entity whose mask asked for it, b what it ran into
+enum class ContactKind : uint8_t { None, EnemyPlayer, EnemyShot, SmallEnemyPlayer, SmallEnemyShot };
+constexpr size_t ContactKinds = 5;
+constexpr const char* ContactKindNames[ContactKinds] = { "none", "enemy-player", "enemy-shot", "small enemy-player", "small enemy-shot" };
+struct Contact { Entity a; Entity b; ContactKind kind = ContactKind::None; };
+
 class Game
 {
+    friend class Benchmark;                         // bench/Benchmark.cpp drives the systems directly
+    friend class Tests;                             // and so does tests/Tests.cpp
+
+    static constexpr float TickTime     = 1.0f / 60.0f;    // length of one simulation tick in seconds
+    static constexpr float MaxFrameTime = 0.25f;           // longest frame the simulation will catch up on
+    static constexpr int   WarmupTicks  = 60;              // ticks left out of the steady state allocation count
+    static constexpr size_t ReservedEntities = 4096;       // entities the arrays are sized for up front
+    static constexpr size_t ReservedCommands = 1024;       // spawn commands per thread per tick, likewise
+    static constexpr size_t ParallelEntities = 1024;       // fewer live entities than this and a tick runs on one thread
+
     sf::RenderWindow    m_window;                   // the window we will draw to
+    sf::Vector2u        m_windowSize;               // play area size, also set when headless
+    GameOptions         m_options;
+    std::vector<ScriptedInput> m_script;            // scripted input sorted by frame
+    size_t              m_nextScriptedInput = 0;
+    JobSystem           m_jobs;                     // worker threads the simulation systems run on
+    SystemScheduler     m_scheduler;                // the systems of one tick and what each of them touches
     EntityManager       m_entities;                 // vector of entities to maintain
+    EntityHandle        m_player;                   // handle to the current player entity
     sf::Font            m_font;                     // the font we will use to draw
     sf::Text            m_text;                     // the score text to be drawn to the screen
+    BatchRenderer       m_batch;                    // all entity shapes, drawn in one call
     PlayerConfig        m_playerConfig;
     EnemyConfig         m_enemyConfig;
     BulletConfig        m_bulletConfig;
+    SpatialHash         m_collisionGrid;            // broadphase for sCollision, rebuilt every frame
+    SpatialIndex        m_enemyIndex;               // where the enemies are, for allies to aim at, rebuilt on demand
+    std::vector<Entity> m_nearestEnemies;           // scratch for m_enemyIndex.kNearest()
+    std::vector<uint32_t> m_allyIds;                // sMovement's batch of live small allies
+    Vec2fArray          m_allyPositions;            // and where they are
+    std::vector<float>  m_allyDistances;            // squared, from the player
+    std::vector<uint32_t> m_orbitIds;               // the allies that reached their orbit
+    Vec2fArray          m_orbitDirections;          // from the player to them, turned a step round
+    std::vector<Entity> m_colliders;                // collidables with a mask, the ones that query the grid
+    std::vector<Contact> m_contacts;                // this frame's overlaps, in the order they are resolved
+    std::vector<std::vector<Contact>> m_contactChunks; // per chunk of colliders, while they are found in parallel
+    ContactKind         m_contactKinds[Layer::Count][Layer::Count] = {};   // response for (a's layer, b's layer)
+    uint32_t            m_layerMasks[Layer::Count] = {};                   // layers each layer looks for, from m_contactKinds
+    int                 m_contactsFound[ContactKinds] = {};                // last tick's contacts by kind, for the Profiler tab
+    int                 m_contactsResolved[ContactKinds] = {};             // and the ones that were acted on
+    TimerWheel<EntityHandle> m_lifespanTimers;      // entities to destroy, filed at spawn
+    TimerWheel<int>     m_cooldownTimers;           // when the special comes off cooldown, by the frame it was fired
+    TimerWheel<int>::Id m_cooldownTimer;            // the pending one, cancelled when the player respawns
+    Profiler            m_profiler;                 // per-system timings shown in the Profiler tab
     sf::Clock           m_deltaClock;
     int                 m_score = 0;
-    int                 m_currentFrame = 0;
+    int                 m_hudScore = 0;             // score m_text currently shows
+    int                 m_currentFrame = 0;         // simulation ticks so far
+    float               m_accumulator = 0.0f;       // real time not yet simulated
+    uint64_t            m_frameAllocations = 0;     // heap allocations made during the last frame
+    uint64_t            m_steadyAllocations = 0;    // heap allocations since the warm-up ticks
     int                 m_lastEnemySpawnTime = 0;
     bool                m_paused = false;           // whether we update game logic
     bool                m_running = true;           // whether the game is running
@@ -45,29 +135,39 @@ class Game
     std::uniform_real_distribution<float>           m_random;
 
     void init(const std::string& config);           // initialize the GameState with a config file
+    void loadScript(const std::string& path);       // read a scripted input file
+    void initScheduler();                           // register the tick's systems with m_scheduler
     void setPaused(bool paused);                    // pause the game
+    void tick();                                    // advance the simulation one fixed step
+    void scheduleLifespans();                       // file the expiry of entities the last update added
 
     void sMovement();                               // System: Entity position / movement update
     void sUserInput();                              // System: User Input
+    void sScriptedInput();                          // System: Input replayed from a script
     void sLifespan();                               // System: Lifespan
     void sCooldown();                               // System: Cooldown
-    void sRender();                                 // System: Render / Drawing
+    void sRender(float alpha);                      // System: Render / Drawing, alpha blends the last two ticks
+    void buildRenderBatch(float alpha);             // fill m_batch with every entity shape
     void sGUI();
     void sEnemySpawner();                           // System: Spawns Enemies
     void sSmallAllyBulletSpawner();                 // System: Spawns Bullets from small Allies
-    void sCollision();                              // System: Collisions
+    void sCollision();                              // System: Collision detection, fills m_contacts
+    void sCollisionResponse();                      // System: Kills, scoring and break-ups for m_contacts
+    void findContacts();
+    void setContact(uint32_t a, uint32_t b, ContactKind kind);
 
     void spawnPlayer();
     void spawnEnemy();
-    void spawnSmallEnemies(std::shared_ptr<Entity> entity);
-    void spawnBullet(std::shared_ptr<Entity> entity, const Vec2f& mousePos);
-    void spawnSpecialWeapon(std::shared_ptr<Entity> entity);
+    void spawnSmallEnemies(Entity entity);
+    void spawnBullet(Entity entity, const Vec2f& mousePos);
+    void spawnSpecialWeapon(Entity entity);
 
-    std::shared_ptr<Entity> player();
+    Entity player();
 
 public:
 
     Game(const std::string& config);                // constructor, takes in game config
+    Game(const GameOptions& options);
 
     void run();
 };
\ No newline at end of file
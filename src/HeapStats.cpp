@@ -0,0 +1,101 @@
+#include "HeapStats.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<uint64_t> g_allocations { 0 };
+    std::atomic<uint64_t> g_frees { 0 };
+
+    void* allocate(std::size_t size)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size ? size : 1);
+    }
+
+    void* allocateAligned(std::size_t size, std::align_val_t align)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        std::size_t alignment = (std::size_t)align;
+#ifdef _MSC_VER
+        return _aligned_malloc(size ? size : 1, alignment);
+#else
+        // aligned_alloc wants the size to be a multiple of the alignment
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    }
+
+    void release(void* p)
+    {
+        if (!p) { return; }
+        g_frees.fetch_add(1, std::memory_order_relaxed);
+        std::free(p);
+    }
+
+    void releaseAligned(void* p)
+    {
+        if (!p) { return; }
+        g_frees.fetch_add(1, std::memory_order_relaxed);
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+}
+
+uint64_t HeapStats::allocations()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t HeapStats::frees()
+{
+    return g_frees.load(std::memory_order_relaxed);
+}
+
+// the array and nothrow forms all end up here too
+void* operator new(std::size_t size)
+{
+    if (void* p = allocate(size)) { return p; }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    if (void* p = allocateAligned(size, align)) { return p; }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align)
+{
+    return operator new(size, align);
+}
+
+void operator delete(void* p) noexcept                                      { release(p); }
+void operator delete[](void* p) noexcept                                    { release(p); }
+void operator delete(void* p, std::size_t) noexcept                         { release(p); }
+void operator delete[](void* p, std::size_t) noexcept                       { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept               { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept             { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept                    { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept                  { releaseAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept       { releaseAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept     { releaseAligned(p); }
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts every heap allocation the program makes. HeapStats.cpp replaces the
+// global operator new / delete with versions that bump a counter and forward
+// to malloc / free, so the game can report how many allocations a frame made
+class HeapStats
+{
+public:
+
+    static uint64_t allocations();      // operator new calls since the program started
+    static uint64_t frees();            // operator delete calls with a non-null pointer
+};
@@ -0,0 +1,137 @@
+#include "JobSystem.hpp"
+
+namespace
+{
+    // which pool the current thread works for, and its queue in that pool
+    thread_local const JobSystem*   t_pool = nullptr;
+    thread_local size_t             t_queue = 0;
+}
+
+JobSystem::JobSystem(size_t threads)
+{
+    if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+
+    size_t workers = threads - 1;
+    for (size_t i = 0; i < workers + 1; i++)
+    {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < workers; i++)
+    {
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+size_t JobSystem::homeQueue() const
+{
+    return t_pool == this ? t_queue : m_queues.size() - 1;
+}
+
+void JobSystem::submit(const Job& job, JobCounter& counter)
+{
+    counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    Queue& queue = *m_queues[homeQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pushBack({ job, &counter });
+    }
+    m_queued.fetch_add(1, std::memory_order_release);
+
+    // taking the sleep mutex orders this against a worker about to sleep, so the wake-up isn't lost
+    if (!m_workers.empty())
+    {
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        m_wake.notify_one();
+    }
+}
+
+// newest job first from our own queue, it is the most likely to still be in cache
+bool JobSystem::pop(size_t queue, Task& task)
+{
+    Queue& q = *m_queues[queue];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.count == 0) { return false; }
+
+    task = q.popBack();
+    return true;
+}
+
+// oldest job first from someone else's queue, it tends to be the biggest piece of work
+bool JobSystem::steal(size_t queue, Task& task)
+{
+    Queue& q = *m_queues[queue];
+    std::unique_lock<std::mutex> lock(q.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || q.count == 0) { return false; }
+
+    task = q.popFront();
+    return true;
+}
+
+bool JobSystem::runOne(size_t home)
+{
+    if (m_queued.load(std::memory_order_acquire) == 0) { return false; }
+
+    Task task;
+    bool found = pop(home, task);
+    for (size_t i = 1; !found && i < m_queues.size(); i++)
+    {
+        found = steal((home + i) % m_queues.size(), task);
+    }
+    if (!found) { return false; }
+
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    task.job();
+
+    // the last job of a counter wakes whoever sleeps in wait() on it, under the
+    // sleep mutex like submit() so the wake-up can't slip in before they sleep
+    if (task.counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        m_wake.notify_all();
+    }
+    return true;
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    size_t home = homeQueue();
+    while (!counter.done())
+    {
+        if (runOne(home)) { continue; }
+
+        // nothing to run, what is left is running on other threads: sleep until
+        // it finishes or a new job turns up to help with
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this, &counter]() { return counter.done() || m_queued.load(std::memory_order_acquire) > 0; });
+    }
+}
+
+void JobSystem::workerLoop(size_t index)
+{
+    t_pool = this;
+    t_queue = index;
+
+    while (true)
+    {
+        if (runOne(index)) { continue; }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() { return m_stop || m_queued.load(std::memory_order_acquire) > 0; });
+        if (m_stop) { return; }
+    }
+}
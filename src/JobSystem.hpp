@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Counts the jobs submitted against it that have not finished yet
+class JobCounter
+{
+    friend class JobSystem;
+
+    std::atomic<size_t> m_pending { 0 };
+
+public:
+
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator = (const JobCounter&) = delete;
+
+    bool done() const
+    {
+        return m_pending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+// A small callable kept inline instead of on the heap like std::function, so
+// queueing a job never allocates. Lambdas capturing a few pointers, references
+// or numbers fit
+class Job
+{
+    static constexpr size_t Capacity = 6 * sizeof(void*);
+
+    alignas(std::max_align_t) unsigned char     m_storage[Capacity];
+    void                                        (*m_invoke)(void*) = nullptr;
+
+public:
+
+    Job() = default;
+
+    template <typename F>
+        requires (!std::is_same_v<F, Job>)
+    Job(F f)
+    {
+        static_assert(sizeof(F) <= Capacity, "job captures too much, capture a pointer to the data instead");
+        static_assert(std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F>,
+            "jobs are copied around as raw bytes");
+
+        new (m_storage) F(f);
+        m_invoke = [](void* f) { (*(F*)f)(); };
+    }
+
+    void operator () ()
+    {
+        m_invoke(m_storage);
+    }
+};
+
+// Work-stealing thread pool. Every worker owns a deque: it pushes and pops its
+// own jobs at the back and, once that runs dry, steals from the front of the
+// others. Threads that are not workers (the main thread) push into one extra
+// shared queue. wait() runs jobs while there are any and only sleeps once the
+// rest are running elsewhere, so a job can submit more jobs and wait on them
+// without tying up its thread
+class JobSystem
+{
+    class Task
+    {
+    public:
+        Job             job;
+        JobCounter*     counter = nullptr;
+    };
+
+    // ring buffer deque, it only grows, so once warmed up pushing and popping never allocates
+    class Queue
+    {
+    public:
+        std::mutex          mutex;
+        std::vector<Task>   tasks   = std::vector<Task>(64);
+        size_t              head    = 0;        // oldest task
+        size_t              count   = 0;
+
+        void pushBack(const Task& task)
+        {
+            if (count == tasks.size())
+            {
+                std::vector<Task> bigger(tasks.size() * 2);
+                for (size_t i = 0; i < count; i++) { bigger[i] = tasks[(head + i) % tasks.size()]; }
+                tasks.swap(bigger);
+                head = 0;
+            }
+            tasks[(head + count) % tasks.size()] = task;
+            count++;
+        }
+
+        Task popBack()
+        {
+            count--;
+            return tasks[(head + count) % tasks.size()];
+        }
+
+        Task popFront()
+        {
+            Task task = tasks[head];
+            head = (head + 1) % tasks.size();
+            count--;
+            return task;
+        }
+    };
+
+    std::vector<std::unique_ptr<Queue>>     m_queues;           // one per worker, the last one is shared by outside threads
+    std::vector<std::thread>                m_workers;
+    std::atomic<size_t>                     m_queued { 0 };     // jobs sitting in any queue
+    std::atomic<bool>                       m_stop { false };
+    std::mutex                              m_sleepMutex;
+    std::condition_variable                 m_wake;
+
+    size_t homeQueue() const;
+    bool pop(size_t queue, Task& task);
+    bool steal(size_t queue, Task& task);
+    bool runOne(size_t home);
+    void workerLoop(size_t index);
+
+public:
+
+    // threads counts the calling thread too, 0 uses one thread per hardware thread
+    explicit JobSystem(size_t threads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator = (const JobSystem&) = delete;
+
+    // workers plus the thread that calls wait()
+    size_t threadCount() const
+    {
+        return m_workers.size() + 1;
+    }
+
+    void submit(const Job& job, JobCounter& counter);
+
+    // runs queued jobs until every job submitted against counter has finished
+    void wait(JobCounter& counter);
+
+    // calls f(begin, end) over [0, count) in chunks of at least grain items,
+    // spread over the pool, and returns once every chunk is done. A range of
+    // one chunk, or a pool of one thread, is run on the calling thread
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, F&& f)
+    {
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = std::min((count + grain - 1) / grain, threadCount() * 4);
+        if (chunks <= 1 || threadCount() == 1)
+        {
+            if (count > 0) { f(size_t(0), count); }
+            return;
+        }
+
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        JobCounter counter;
+        for (size_t begin = chunkSize; begin < count; begin += chunkSize)
+        {
+            size_t end = std::min(begin + chunkSize, count);
+            submit([&f, begin, end]() { f(begin, end); }, counter);
+        }
+        f(size_t(0), chunkSize);
+        wait(counter);
+    }
+};
@@ -0,0 +1,265 @@
+#include "Kernels.hpp"
+
+#include <cstring>
+
+// x86-64 only, where SSE2 is always there
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define KERNELS_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic, GCC and Clang need the target spelled out
+#if KERNELS_X86 && !defined(_MSC_VER)
+#define KERNELS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNELS_TARGET(isa)
+#endif
+
+static_assert(sizeof(Vec2f) == 2 * sizeof(float), "kernels read Vec2f arrays as packed x, y floats");
+
+using Kernels::Isa;
+
+namespace
+{
+    // ---- scalar, also finishes off the tail of the SIMD loops ----
+
+    void integrateScalar(Vec2f* positions, const Vec2f* velocities, float* angles,
+        size_t begin, size_t end, float spin)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            positions[i] += velocities[i];
+            angles[i] += spin;
+        }
+    }
+
+    void bounceScalar(const Vec2f* positions, Vec2f* velocities, const TagId* tags, TagId tag,
+        float radius, float width, float height, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            if (tags[i] != tag) { continue; }
+
+            const Vec2f& pos = positions[i];
+            if ((pos.x + radius) > width || (pos.x - radius) < 0)
+            {
+                velocities[i].x *= -1;
+            }
+            else if ((pos.y + radius) > height || (pos.y - radius) < 0)
+            {
+                velocities[i].y *= -1;
+            }
+        }
+    }
+
+#if KERNELS_X86
+
+    // ---- SSE2, 2 slots of x, y per register ----
+
+    KERNELS_TARGET("sse2")
+    void integrateSSE2(Vec2f* positions, const Vec2f* velocities, float* angles,
+        size_t begin, size_t end, float spin)
+    {
+        float* p = (float*)positions;
+        const float* v = (const float*)velocities;
+        __m128 s = _mm_set1_ps(spin);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            _mm_storeu_ps(p + 2 * i,     _mm_add_ps(_mm_loadu_ps(p + 2 * i),     _mm_loadu_ps(v + 2 * i)));
+            _mm_storeu_ps(p + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(p + 2 * i + 4), _mm_loadu_ps(v + 2 * i + 4)));
+            _mm_storeu_ps(angles + i,    _mm_add_ps(_mm_loadu_ps(angles + i), s));
+        }
+        integrateScalar(positions, velocities, angles, i, end, spin);
+    }
+
+    KERNELS_TARGET("sse2")
+    void bounceSSE2(const Vec2f* positions, Vec2f* velocities, const TagId* tags, TagId tag,
+        float radius, float width, float height, size_t begin, size_t end)
+    {
+        const float* p = (const float*)positions;
+        float* v = (float*)velocities;
+        __m128 r = _mm_set1_ps(radius);
+        __m128 bound = _mm_setr_ps(width, height, width, height);
+        __m128 zero = _mm_setzero_ps();
+        __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 yLanes = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, -1));
+        __m128i wanted = _mm_set1_epi16((short)tag);
+
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2)
+        {
+            // one mask per slot, widened to cover both its x and y lanes
+            int32_t twoTags;
+            std::memcpy(&twoTags, tags + i, sizeof(twoTags));
+            __m128i match = _mm_cmpeq_epi16(_mm_cvtsi32_si128(twoTags), wanted);
+            match = _mm_unpacklo_epi16(match, match);
+            __m128 tagged = _mm_castsi128_ps(_mm_unpacklo_epi32(match, match));
+
+            __m128 pos = _mm_loadu_ps(p + 2 * i);
+            __m128 out = _mm_or_ps(_mm_cmpgt_ps(_mm_add_ps(pos, r), bound), _mm_cmplt_ps(_mm_sub_ps(pos, r), zero));
+
+            // y only flips when x didn't
+            __m128 outX = _mm_shuffle_ps(out, out, _MM_SHUFFLE(2, 2, 0, 0));
+            __m128 flip = _mm_andnot_ps(_mm_and_ps(outX, yLanes), _mm_and_ps(out, tagged));
+
+            __m128 vel = _mm_loadu_ps(v + 2 * i);
+            _mm_storeu_ps(v + 2 * i, _mm_xor_ps(vel, _mm_and_ps(flip, sign)));
+        }
+        bounceScalar(positions, velocities, tags, tag, radius, width, height, i, end);
+    }
+
+    // ---- AVX2, 4 slots of x, y per register, 8 slots per iteration ----
+
+    KERNELS_TARGET("avx2")
+    void integrateAVX2(Vec2f* positions, const Vec2f* velocities, float* angles,
+        size_t begin, size_t end, float spin)
+    {
+        float* p = (float*)positions;
+        const float* v = (const float*)velocities;
+        __m256 s = _mm256_set1_ps(spin);
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            _mm256_storeu_ps(p + 2 * i,     _mm256_add_ps(_mm256_loadu_ps(p + 2 * i),     _mm256_loadu_ps(v + 2 * i)));
+            _mm256_storeu_ps(p + 2 * i + 8, _mm256_add_ps(_mm256_loadu_ps(p + 2 * i + 8), _mm256_loadu_ps(v + 2 * i + 8)));
+            _mm256_storeu_ps(angles + i,    _mm256_add_ps(_mm256_loadu_ps(angles + i), s));
+        }
+        integrateScalar(positions, velocities, angles, i, end, spin);
+    }
+
+    KERNELS_TARGET("avx2")
+    void bounceAVX2(const Vec2f* positions, Vec2f* velocities, const TagId* tags, TagId tag,
+        float radius, float width, float height, size_t begin, size_t end)
+    {
+        const float* p = (const float*)positions;
+        float* v = (float*)velocities;
+        __m256 r = _mm256_set1_ps(radius);
+        __m256 bound = _mm256_setr_ps(width, height, width, height, width, height, width, height);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 yLanes = _mm256_castsi256_ps(_mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1));
+        __m128i wanted = _mm_set1_epi16((short)tag);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            // 4 16 bit tag masks sign extended to one 64 bit x, y pair each
+            __m128i match = _mm_cmpeq_epi16(_mm_loadl_epi64((const __m128i*)(tags + i)), wanted);
+            __m256 tagged = _mm256_castsi256_ps(_mm256_cvtepi16_epi64(match));
+
+            __m256 pos = _mm256_loadu_ps(p + 2 * i);
+            __m256 out = _mm256_or_ps(_mm256_cmp_ps(_mm256_add_ps(pos, r), bound, _CMP_GT_OQ),
+                                      _mm256_cmp_ps(_mm256_sub_ps(pos, r), zero, _CMP_LT_OQ));
+
+            // y only flips when x didn't
+            __m256 outX = _mm256_moveldup_ps(out);
+            __m256 flip = _mm256_andnot_ps(_mm256_and_ps(outX, yLanes), _mm256_and_ps(out, tagged));
+
+            __m256 vel = _mm256_loadu_ps(v + 2 * i);
+            _mm256_storeu_ps(v + 2 * i, _mm256_xor_ps(vel, _mm256_and_ps(flip, sign)));
+        }
+        bounceScalar(positions, velocities, tags, tag, radius, width, height, i, end);
+    }
+
+    bool cpuHasAVX2()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) { return false; }
+
+        // AVX2 also needs the OS to save the ymm registers on a context switch
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) { return false; }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+#endif
+
+    Isa detect()
+    {
+#if KERNELS_X86
+        if (cpuHasAVX2()) { return Isa::AVX2; }
+        return Isa::SSE2;
+#else
+        return Isa::Scalar;
+#endif
+    }
+
+    Isa& active()
+    {
+        static Isa isa = detect();
+        return isa;
+    }
+}
+
+namespace Kernels
+{
+    Isa best()
+    {
+        static Isa isa = detect();
+        return isa;
+    }
+
+    Isa current()
+    {
+        return active();
+    }
+
+    void use(Isa isa)
+    {
+        active() = (int)isa <= (int)best() ? isa : best();
+    }
+
+    const char* name(Isa isa)
+    {
+        switch (isa)
+        {
+            case Isa::AVX2: return "avx2";
+            case Isa::SSE2: return "sse2";
+            default:        return "scalar";
+        }
+    }
+
+    void integrate(Vec2f* positions, const Vec2f* velocities, float* angles,
+        size_t begin, size_t end, float spin)
+    {
+        switch (active())
+        {
+#if KERNELS_X86
+            case Isa::AVX2: integrateAVX2(positions, velocities, angles, begin, end, spin); break;
+            case Isa::SSE2: integrateSSE2(positions, velocities, angles, begin, end, spin); break;
+#endif
+            default:        integrateScalar(positions, velocities, angles, begin, end, spin); break;
+        }
+    }
+
+    void bounce(const Vec2f* positions, Vec2f* velocities, const TagId* tags, TagId tag,
+        float radius, float width, float height, size_t begin, size_t end)
+    {
+        switch (active())
+        {
+#if KERNELS_X86
+            case Isa::AVX2: bounceAVX2(positions, velocities, tags, tag, radius, width, height, begin, end); break;
+            case Isa::SSE2: bounceSSE2(positions, velocities, tags, tag, radius, width, height, begin, end); break;
+#endif
+            default:        bounceScalar(positions, velocities, tags, tag, radius, width, height, begin, end); break;
+        }
+    }
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Tags.hpp"
+#include "Vec2.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Per-slot math over the raw component arrays. The kernels only see plain
+// arrays and a slot range, never entities, so any range can be handed to a
+// different thread. Every kernel has a scalar, an SSE2 and an AVX2 version;
+// the widest one the CPU supports is picked the first time one is called
+namespace Kernels
+{
+    enum class Isa { Scalar, SSE2, AVX2 };
+
+    Isa best();                         // widest instruction set this CPU supports
+    Isa current();                      // the one the kernels are using
+    void use(Isa isa);                  // switch, e.g. to benchmark; clamped to best()
+    const char* name(Isa isa);
+
+    // pos += velocity and angle += spin for slots [begin, end)
+    // free slots have zero velocity and get overwritten when reused, so every
+    // slot is integrated instead of branching on whether it is alive
+    void integrate(Vec2f* positions, const Vec2f* velocities, float* angles,
+        size_t begin, size_t end, float spin);
+
+    // reflects the velocity of slots tagged `tag` whose circle pokes out of the
+    // [0, width] x [0, height] play area: x if it's out sideways, else y if it's
+    // out at the top or bottom
+    void bounce(const Vec2f* positions, Vec2f* velocities, const TagId* tags, TagId tag,
+        float radius, float width, float height, size_t begin, size_t end);
+
+}
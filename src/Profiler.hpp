@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Profiler;
+
+// Times the scope it lives in and adds the result to a Profiler section
+class ProfileTimer
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    Profiler&           m_profiler;
+    size_t              m_section;
+    Clock::time_point   m_start;
+
+public:
+
+    ProfileTimer(Profiler& profiler, size_t section)
+        : m_profiler(profiler)
+        , m_section(section)
+        , m_start(Clock::now())
+    {}
+
+    ProfileTimer(const ProfileTimer&) = delete;
+    ProfileTimer& operator = (const ProfileTimer&) = delete;
+
+    ~ProfileTimer();
+};
+
+// Keeps the time spent in each named section over the last HistorySize frames.
+// Several timings of the same section within one frame (e.g. several
+// simulation ticks) add up. Names containing a '/' are sub-sections of the
+// part before the slash, and are left out of the frame total. Timers may
+// finish on any thread, the scheduler runs systems on the job system
+class Profiler
+{
+public:
+
+    static constexpr size_t HistorySize = 240;
+
+    class Section
+    {
+    public:
+        std::string                         name;
+        bool                                nested  = false;
+        float                               current = 0.0f;     // ms so far this frame
+        std::array<float, HistorySize>      history {};         // ms per frame, ring buffer
+    };
+
+private:
+
+    std::vector<Section>    m_sections;
+    size_t                  m_frame = 0;            // frames recorded so far
+    std::mutex              m_mutex;                // guards m_sections while systems run on several threads
+
+public:
+
+    // index of a section, registering it the first time it is used
+    // takes a string_view so timing a section by a literal name doesn't build a std::string
+    size_t section(std::string_view name)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_sections.size(); i++)
+        {
+            if (m_sections[i].name == name) { return i; }
+        }
+
+        Section s;
+        s.name = name;
+        s.nested = name.find('/') != std::string_view::npos;
+        m_sections.push_back(s);
+        return m_sections.size() - 1;
+    }
+
+    ProfileTimer time(std::string_view name)
+    {
+        return ProfileTimer(*this, section(name));
+    }
+
+    void record(size_t section, float ms)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sections[section].current += ms;
+    }
+
+    // push this frame's timings into the history and start a new frame
+    void endFrame()
+    {
+        size_t slot = m_frame % HistorySize;
+        for (auto& s : m_sections)
+        {
+            s.history[slot] = s.current;
+            s.current = 0.0f;
+        }
+        m_frame++;
+    }
+
+    const std::vector<Section>& sections() const
+    {
+        return m_sections;
+    }
+
+    // number of frames of history available, at most HistorySize
+    size_t frames() const
+    {
+        return std::min(m_frame, HistorySize);
+    }
+
+    // ms a section took `age` frames ago, age 0 being the last finished frame
+    float at(const Section& s, size_t age) const
+    {
+        return s.history[(m_frame - 1 - age) % HistorySize];
+    }
+
+    float average(const Section& s) const
+    {
+        if (frames() == 0) { return 0.0f; }
+
+        float total = 0.0f;
+        for (size_t i = 0; i < frames(); i++) { total += s.history[i]; }
+        return total / frames();
+    }
+
+    float percentile(const Section& s, float p) const
+    {
+        if (frames() == 0) { return 0.0f; }
+
+        std::vector<float> sorted(s.history.begin(), s.history.begin() + frames());
+        size_t n = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+        return sorted[n];
+    }
+};
+
+inline ProfileTimer::~ProfileTimer()
+{
+    std::chrono::duration<float, std::milli> elapsed = Clock::now() - m_start;
+    m_profiler.record(m_section, elapsed.count());
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "Entity.hpp"
+#include "Vec2.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid broadphase. Each frame the grid is cleared, filled with insert()
+// and sorted into its cells with build(), after which query(), queryAABB() and
+// nearest() only look at the cells around the area they are asked about. Cells are hashed into a table sized from the
+// item count instead of a dense array, so entities outside the window still work
+class SpatialHash
+{
+public:
+
+    class Item
+    {
+    public:
+        Entity      entity;
+        Vec2f       pos;
+        float       radius  = 0;
+        uint32_t    layer   = 0;        // caller's filter, e.g. a collision layer bit or a tag
+        int32_t     cellX   = 0;
+        int32_t     cellY   = 0;
+    };
+
+private:
+
+    float                   m_cellSize      = 64.0f;
+    float                   m_invCellSize   = 1.0f / 64.0f;
+    float                   m_maxRadius     = 0.0f;     // largest radius inserted since clear()
+    size_t                  m_bucketMask    = 0;
+    std::vector<Item>       m_items;                    // items in insertion order
+    std::vector<Item>       m_sorted;                   // items grouped by bucket after build()
+    std::vector<uint32_t>   m_bucketStart;              // bucket b is m_sorted[m_bucketStart[b], m_bucketStart[b + 1])
+    std::vector<uint32_t>   m_bucketFill;
+    int32_t                 m_minCellX = 0, m_minCellY = 0;     // cells the items span, set by build()
+    int32_t                 m_maxCellX = 0, m_maxCellY = 0;
+
+    int32_t cellCoord(float v) const
+    {
+        return (int32_t)std::floor(v * m_invCellSize);
+    }
+
+    size_t bucket(int32_t cellX, int32_t cellY) const
+    {
+        return (((uint32_t)cellX * 73856093u) ^ ((uint32_t)cellY * 19349663u)) & m_bucketMask;
+    }
+
+    // calls f(item) for every item in one cell, f returns true to stop
+    template <typename F>
+    bool visitCell(int32_t cellX, int32_t cellY, F&& f) const
+    {
+        size_t b = bucket(cellX, cellY);
+        for (uint32_t i = m_bucketStart[b]; i < m_bucketStart[b + 1]; i++)
+        {
+            const Item& item = m_sorted[i];
+
+            // other cells can hash to the same bucket
+            if (item.cellX != cellX || item.cellY != cellY) { continue; }
+            if (f(item)) { return true; }
+        }
+        return false;
+    }
+
+public:
+
+    SpatialHash() = default;
+
+    // the cell size should be at least twice the largest radius that will be inserted
+    SpatialHash(float cellSize)
+        : m_cellSize(cellSize)
+        , m_invCellSize(1.0f / cellSize)
+    {}
+
+    float cellSize() const
+    {
+        return m_cellSize;
+    }
+
+    size_t size() const
+    {
+        return m_items.size();
+    }
+
+    // room for this many items, so filling and building the grid doesn't allocate
+    void reserve(size_t items)
+    {
+        size_t buckets = 16;
+        while (buckets < items * 2) { buckets *= 2; }
+        m_items.reserve(items);
+        m_sorted.reserve(items);
+        m_bucketStart.reserve(buckets + 1);
+        m_bucketFill.reserve(buckets);
+    }
+
+    void clear()
+    {
+        m_items.clear();
+        m_maxRadius = 0.0f;
+    }
+
+    void insert(const Entity& entity, const Vec2f& pos, float radius, uint32_t layer = 0)
+    {
+        m_items.push_back({ entity, pos, radius, layer, cellCoord(pos.x), cellCoord(pos.y) });
+        m_maxRadius = std::max(m_maxRadius, radius);
+    }
+
+    // counting sort of the inserted items into their buckets, O(items)
+    void build()
+    {
+        size_t buckets = 16;
+        while (buckets < m_items.size() * 2) { buckets *= 2; }
+        m_bucketMask = buckets - 1;
+
+        m_bucketStart.assign(buckets + 1, 0);
+        m_minCellX = m_minCellY = INT32_MAX;
+        m_maxCellX = m_maxCellY = INT32_MIN;
+        for (auto& item : m_items)
+        {
+            m_bucketStart[bucket(item.cellX, item.cellY) + 1]++;
+            m_minCellX = std::min(m_minCellX, item.cellX);
+            m_minCellY = std::min(m_minCellY, item.cellY);
+            m_maxCellX = std::max(m_maxCellX, item.cellX);
+            m_maxCellY = std::max(m_maxCellY, item.cellY);
+        }
+        for (size_t b = 0; b < buckets; b++)
+        {
+            m_bucketStart[b + 1] += m_bucketStart[b];
+        }
+
+        m_bucketFill.assign(m_bucketStart.begin(), m_bucketStart.end() - 1);
+        m_sorted.resize(m_items.size());
+        for (auto& item : m_items)
+        {
+            m_sorted[m_bucketFill[bucket(item.cellX, item.cellY)]++] = item;
+        }
+    }
+
+    // calls f(item) for every item whose circle overlaps the given circle
+    // f returns true to stop the query early, in which case query returns true
+    template <typename F>
+    bool query(const Vec2f& pos, float radius, F&& f) const
+    {
+        if (m_sorted.empty()) { return false; }
+
+        // only the cells both in reach and within the span of the items can hold anything
+        float reach = radius + m_maxRadius;
+        int32_t minX = std::max(cellCoord(pos.x - reach), m_minCellX), maxX = std::min(cellCoord(pos.x + reach), m_maxCellX);
+        int32_t minY = std::max(cellCoord(pos.y - reach), m_minCellY), maxY = std::min(cellCoord(pos.y + reach), m_maxCellY);
+
+        for (int32_t cy = minY; cy <= maxY; cy++)
+        {
+            for (int32_t cx = minX; cx <= maxX; cx++)
+            {
+                bool stop = visitCell(cx, cy, [&](const Item& item)
+                {
+                    float r = radius + item.radius;
+                    return item.pos.distSquared(pos) < r * r && f(item);
+                });
+                if (stop) { return true; }
+            }
+        }
+        return false;
+    }
+
+    // calls f(item) for every item whose circle touches the box [min, max],
+    // f returns true to stop the query early, in which case queryAABB returns true
+    template <typename F>
+    bool queryAABB(const Vec2f& min, const Vec2f& max, F&& f) const
+    {
+        if (m_sorted.empty()) { return false; }
+
+        int32_t minX = std::max(cellCoord(min.x - m_maxRadius), m_minCellX), maxX = std::min(cellCoord(max.x + m_maxRadius), m_maxCellX);
+        int32_t minY = std::max(cellCoord(min.y - m_maxRadius), m_minCellY), maxY = std::min(cellCoord(max.y + m_maxRadius), m_maxCellY);
+
+        for (int32_t cy = minY; cy <= maxY; cy++)
+        {
+            for (int32_t cx = minX; cx <= maxX; cx++)
+            {
+                bool stop = visitCell(cx, cy, [&](const Item& item)
+                {
+                    Vec2f closest(std::clamp(item.pos.x, min.x, max.x), std::clamp(item.pos.y, min.y, max.y));
+                    return item.pos.distSquared(closest) <= item.radius * item.radius && f(item);
+                });
+                if (stop) { return true; }
+            }
+        }
+        return false;
+    }
+
+    // the (up to) k items nearest to pos by centre that pass filter(item),
+    // nearest first. Cells are visited in square rings around pos's cell and
+    // the search stops once no further ring can hold anything closer than the
+    // k-th best found so far, or falls back to a scan once rings get too big
+    template <typename F>
+    void nearest(const Vec2f& pos, size_t k, F&& filter, std::vector<const Item*>& out) const
+    {
+        out.clear();
+        if (m_sorted.empty() || k == 0) { return; }
+
+        int32_t cx = cellCoord(pos.x), cy = cellCoord(pos.y);
+        auto closer = [&](const Item* a, const Item* b) { return a->pos.distSquared(pos) < b->pos.distSquared(pos); };
+        auto consider = [&](const Item& item)
+        {
+            if (!filter(item)) { return false; }
+            if (out.size() < k)
+            {
+                out.push_back(&item);
+                std::push_heap(out.begin(), out.end(), closer);
+            }
+            else if (closer(&item, out.front()))
+            {
+                std::pop_heap(out.begin(), out.end(), closer);
+                out.back() = &item;
+                std::push_heap(out.begin(), out.end(), closer);
+            }
+            return false;
+        };
+
+        // past this ring there are no items at all
+        int32_t lastRing = std::max({ cx - m_minCellX, m_maxCellX - cx, cy - m_minCellY, m_maxCellY - cy });
+        for (int32_t ring = 0; ring <= lastRing; ring++)
+        {
+            // pos can be anywhere in its cell, so a ring is at least ring - 1 cells away
+            float gap = (ring - 1) * m_cellSize;
+            if (out.size() == k && ring > 0 && gap * gap >= out.front()->pos.distSquared(pos)) { break; }
+
+            // when the items are spread thin a ring has more cells than there are
+            // items, so whatever is left is checked directly instead
+            if (8 * (size_t)ring > m_sorted.size())
+            {
+                for (const Item& item : m_sorted)
+                {
+                    if (std::max(std::abs(item.cellX - cx), std::abs(item.cellY - cy)) >= ring) { consider(item); }
+                }
+                break;
+            }
+
+            for (int32_t dy = -ring; dy <= ring; dy++)
+            {
+                // the top and bottom rows of the ring are whole, the rows between only have their two ends
+                int32_t step = (dy == -ring || dy == ring) ? 1 : std::max(2 * ring, 1);
+                for (int32_t dx = -ring; dx <= ring; dx += step)
+                {
+                    visitCell(cx + dx, cy + dy, consider);
+                }
+            }
+        }
+
+        std::sort_heap(out.begin(), out.end(), closer);
+    }
+};
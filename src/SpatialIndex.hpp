@@ -0,0 +1,101 @@
+#pragma once
+
+#include "EntityManager.hpp"
+#include "SpatialHash.hpp"
+#include <initializer_list>
+#include <vector>
+
+// "What is near this point" for gameplay code: radius, box and k-nearest
+// lookups over the centres of the live entities with the tags the index was
+// made for, each lookup narrowed to the tags it asks for. Only the indexed
+// tags' lists are walked to build it, so an index of the enemies costs
+// nothing per bullet. The grid is rebuilt the first time refresh() is called
+// in a frame, so frames where nothing asks pay nothing, and every lookup after
+// that only looks at the cells around the area it is asked about
+class SpatialIndex
+{
+    SpatialHash                             m_grid;
+    std::vector<TagId>                      m_tags;         // the (up to 32) tags this index holds, an item's layer is the bit of its tag's place here
+    int                                     m_frame = -1;   // frame the grid was built for
+    std::vector<const SpatialHash::Item*>   m_nearest;      // scratch for kNearest()
+
+    // layer bits of the given tags, a tag the index doesn't hold matches nothing
+    uint32_t layers(std::initializer_list<TagId> tags) const
+    {
+        uint32_t bits = 0;
+        for (TagId tag : tags)
+        {
+            for (size_t i = 0; i < m_tags.size(); i++)
+            {
+                if (m_tags[i] == tag) { bits |= 1u << i; }
+            }
+        }
+        return bits;
+    }
+
+public:
+
+    SpatialIndex() = default;
+
+    SpatialIndex(std::initializer_list<TagId> tags, float cellSize = 64.0f)
+        : m_grid(cellSize)
+        , m_tags(tags)
+    {}
+
+    // room for this many entities and lookups of up to k, so neither allocates
+    void reserve(size_t entities, size_t k)
+    {
+        m_grid.reserve(entities);
+        m_nearest.reserve(k);
+    }
+
+    // rebuilds the grid from the entities' current positions unless it already was this frame
+    void refresh(EntityManager& entities, int frame)
+    {
+        if (frame == m_frame) { return; }
+        m_frame = frame;
+
+        m_grid.clear();
+        for (size_t i = 0; i < m_tags.size(); i++)
+        {
+            for (auto& e : entities.getEntities(m_tags[i]))
+            {
+                if (e.isActive()) { m_grid.insert(e, e.get<CTransform>().pos, 0.0f, 1u << i); }
+            }
+        }
+        m_grid.build();
+    }
+
+    // calls f(entity) for every indexed entity with one of the tags whose centre is within radius of pos
+    template <typename F>
+    void queryRadius(const Vec2f& pos, float radius, std::initializer_list<TagId> tags, F&& f) const
+    {
+        uint32_t bits = layers(tags);
+        m_grid.query(pos, radius, [&](const SpatialHash::Item& item)
+        {
+            if (item.layer & bits) { f(item.entity); }
+            return false;
+        });
+    }
+
+    // calls f(entity) for every indexed entity with one of the tags whose centre is inside the box [min, max]
+    template <typename F>
+    void queryAABB(const Vec2f& min, const Vec2f& max, std::initializer_list<TagId> tags, F&& f) const
+    {
+        uint32_t bits = layers(tags);
+        m_grid.queryAABB(min, max, [&](const SpatialHash::Item& item)
+        {
+            if (item.layer & bits) { f(item.entity); }
+            return false;
+        });
+    }
+
+    // the (up to) k indexed entities with one of the tags nearest to pos, nearest first
+    void kNearest(const Vec2f& pos, size_t k, std::initializer_list<TagId> tags, std::vector<Entity>& out)
+    {
+        uint32_t bits = layers(tags);
+        m_grid.nearest(pos, k, [bits](const SpatialHash::Item& item) { return (item.layer & bits) != 0; }, m_nearest);
+        out.clear();
+        for (const SpatialHash::Item* item : m_nearest) { out.push_back(item->entity); }
+    }
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Entity.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// What a system touches: one bit per component type, plus bits for the shared
+// state that isn't a component
+using AccessMask = uint32_t;
+
+namespace Access
+{
+    template <typename... Ts>
+    constexpr AccessMask components()
+    {
+        return componentMask<Ts...>();
+    }
+
+    // resources take the bits counting down from just under the state bits
+    template <typename... Ts>
+    constexpr AccessMask resources()
+    {
+        return ((AccessMask(1) << (28 - ResourceIndex<Ts>)) | ... | AccessMask(0));
+    }
+
+    constexpr AccessMask Alive      = AccessMask(1) << 29;  // active flags, written by destroy()
+    constexpr AccessMask Entities   = AccessMask(1) << 30;  // entity lists, tags and array sizes, written by addEntity()
+    constexpr AccessMask GameState  = AccessMask(1) << 31;  // score, spawn timers, the player handle and the RNG
+
+    static_assert(std::tuple_size_v<ComponentTuple> + std::tuple_size_v<ResourceTuple> <= 29,
+        "component and resource bits overlap each other or the state bits");
+}
+
+// Runs a fixed list of systems once per tick on a JobSystem. Each system
+// declares what it reads and writes, and a system waits only for the earlier
+// systems it conflicts with (one writes what the other reads or writes).
+// Non-conflicting systems run at the same time, and the result is the same
+// as running them one after another in the order they were added
+class SystemScheduler
+{
+    class System
+    {
+    public:
+        std::string             name;
+        AccessMask              reads   = 0;
+        AccessMask              writes  = 0;
+        std::function<void()>   run;
+        std::vector<size_t>     dependents;         // later systems that wait for this one
+        uint32_t                dependencies = 0;   // earlier systems this one waits for
+    };
+
+    std::vector<System>                 m_systems;
+    std::vector<std::atomic<uint32_t>>  m_remaining;    // dependencies not finished yet this run
+
+    void start(size_t index, JobSystem& jobs, JobCounter& counter)
+    {
+        jobs.submit([this, index, &jobs, &counter]()
+        {
+            m_systems[index].run();
+            for (size_t d : m_systems[index].dependents)
+            {
+                if (m_remaining[d].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    start(d, jobs, counter);
+                }
+            }
+        }, counter);
+    }
+
+public:
+
+    void add(const std::string& name, AccessMask reads, AccessMask writes, std::function<void()> run)
+    {
+        System system;
+        system.name = name;
+        system.reads = reads;
+        system.writes = writes;
+        system.run = std::move(run);
+
+        for (size_t i = 0; i < m_systems.size(); i++)
+        {
+            System& earlier = m_systems[i];
+            if ((earlier.writes & (reads | writes)) || (earlier.reads & writes))
+            {
+                earlier.dependents.push_back(m_systems.size());
+                system.dependencies++;
+            }
+        }
+        m_systems.push_back(std::move(system));
+        m_remaining = std::vector<std::atomic<uint32_t>>(m_systems.size());
+    }
+
+    // runs every system once and returns when they have all finished
+    void run(JobSystem& jobs)
+    {
+        for (size_t i = 0; i < m_systems.size(); i++)
+        {
+            m_remaining[i].store(m_systems[i].dependencies, std::memory_order_relaxed);
+        }
+
+        JobCounter counter;
+        for (size_t i = 0; i < m_systems.size(); i++)
+        {
+            if (m_systems[i].dependencies == 0) { start(i, jobs, counter); }
+        }
+        jobs.wait(counter);
+    }
+
+    // runs every system on the calling thread in the order they were added,
+    // for ticks too small to be worth handing to the pool
+    void runInOrder()
+    {
+        for (auto& system : m_systems)
+        {
+            system.run();
+        }
+    }
+
+    // names of the earlier systems a system waits for, for the GUI
+    std::vector<std::string> dependencies(size_t index) const
+    {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < index; i++)
+        {
+            const auto& dependents = m_systems[i].dependents;
+            if (std::find(dependents.begin(), dependents.end(), index) != dependents.end())
+            {
+                names.push_back(m_systems[i].name);
+            }
+        }
+        return names;
+    }
+
+    size_t size() const
+    {
+        return m_systems.size();
+    }
+
+    const std::string& name(size_t index) const
+    {
+        return m_systems[index].name;
+    }
+};
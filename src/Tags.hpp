@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+using TagId = uint16_t;
+
+// The tags the game uses are compile-time constants so that systems compare
+// and index by integer. Any other tag is interned by the EntityManager at
+// runtime and gets the next id after Tag::BuiltinCount
+namespace Tag
+{
+    constexpr TagId Default         = 0;
+    constexpr TagId Player          = 1;
+    constexpr TagId Enemy           = 2;
+    constexpr TagId SmallEnemy      = 3;
+    constexpr TagId Bullet          = 4;
+    constexpr TagId SmallAlly       = 5;
+    constexpr TagId BuiltinCount    = 6;
+
+    constexpr const char* BuiltinNames[BuiltinCount] =
+    {
+        "default",
+        "player",
+        "enemy",
+        "smallEnemy",
+        "bullet",
+        "smallAlly"
+    };
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel keyed on the simulation frame. A timer is filed
+// once, in a slot of the level whose span covers how far away it is, and
+// advance() only ever looks at the slot for the frame it is on. When the
+// lowest level wraps, the next level's slot for the coming stretch is
+// re-filed into the levels below, so each timer is touched a handful of
+// times in its life instead of once per frame.
+//
+// Timers live in one pool and each slot is a list threaded through it, so
+// filing, cascading and firing only move indices around. Once the pool has
+// grown to the most timers ever pending at once (or reserve() sized it), the
+// wheel doesn't allocate. cancel() only marks the timer, it goes back to the
+// pool when its slot next comes up
+template <typename T>
+class TimerWheel
+{
+    static constexpr int SlotBits   = 6;
+    static constexpr int Slots      = 1 << SlotBits;
+    static constexpr int SlotMask   = Slots - 1;
+    static constexpr int Levels     = 4;                        // 2^24 frames, over 77 hours at 60 ticks a second
+    static constexpr uint32_t None  = UINT32_MAX;
+
+    class Timer
+    {
+    public:
+        int         due         = 0;
+        T           value       {};
+        uint32_t    next        = None;                         // next timer in the same slot, or in the free list
+        uint32_t    generation  = 0;                            // bumped when it fires or is cancelled, so old ids miss
+        bool        cancelled   = false;
+    };
+
+    // timers in the order they were filed, so timers due on the same frame fire in that order
+    class Slot
+    {
+    public:
+        uint32_t    head    = None;
+        uint32_t    tail    = None;
+    };
+
+    std::vector<Timer>  m_timers;                               // the pool
+    uint32_t            m_free  = None;                         // unused timers in the pool
+    Slot                m_slots[Levels][Slots];
+    int                 m_now   = 0;                            // last frame advance() processed
+    size_t              m_count = 0;
+
+    void append(Slot& slot, uint32_t index)
+    {
+        m_timers[index].next = None;
+        if (slot.tail == None) { slot.head = index; }
+        else { m_timers[slot.tail].next = index; }
+        slot.tail = index;
+    }
+
+    // due must not be before m_now, a timer due at m_now lands in the slot about to fire
+    void file(uint32_t index)
+    {
+        const Timer& timer = m_timers[index];
+        int delta = timer.due - m_now;
+        int level = 0;
+        while (level < Levels - 1 && delta >= (1 << (SlotBits * (level + 1)))) { level++; }
+
+        // past the top level's span the timer is parked in its last slot and re-filed from there
+        int due = delta < (1 << (SlotBits * Levels)) ? timer.due : m_now + (1 << (SlotBits * Levels)) - 1;
+        append(m_slots[level][(due >> (SlotBits * level)) & SlotMask], index);
+    }
+
+    void release(uint32_t index)
+    {
+        m_timers[index].next = m_free;
+        m_free = index;
+    }
+
+    // empties a slot and returns the first timer that was in it
+    uint32_t take(Slot& slot)
+    {
+        uint32_t head = slot.head;
+        slot = Slot();
+        return head;
+    }
+
+    // moves the level's slot for the current frame down into the levels below it
+    void cascade(int level)
+    {
+        uint32_t index = take(m_slots[level][(m_now >> (SlotBits * level)) & SlotMask]);
+        while (index != None)
+        {
+            uint32_t next = m_timers[index].next;
+            if (m_timers[index].cancelled) { release(index); }
+            else { file(index); }
+            index = next;
+        }
+    }
+
+public:
+
+    // names a scheduled timer for cancel(), and stops naming it once the timer has fired
+    class Id
+    {
+    public:
+        uint32_t    index       = None;
+        uint32_t    generation  = 0;
+    };
+
+    explicit TimerWheel(int frame = 0)
+        : m_now(frame)
+    {}
+
+    // timers that have not fired yet
+    size_t size() const
+    {
+        return m_count;
+    }
+
+    // sizes the pool for this many pending timers
+    void reserve(size_t timers)
+    {
+        m_timers.reserve(timers);
+    }
+
+    // value comes back out of advance() on frame `due`, or on the next frame
+    // processed if due has already gone by
+    Id schedule(int due, const T& value)
+    {
+        if (due <= m_now) { due = m_now + 1; }
+
+        uint32_t index = m_free;
+        if (index != None) { m_free = m_timers[index].next; }
+        else
+        {
+            index = (uint32_t)m_timers.size();
+            m_timers.emplace_back();
+        }
+
+        Timer& timer = m_timers[index];
+        timer.due = due;
+        timer.value = value;
+        timer.cancelled = false;
+        file(index);
+        m_count++;
+        return { index, timer.generation };
+    }
+
+    // stops a timer from firing, an id whose timer already fired or was cancelled is ignored
+    void cancel(Id id)
+    {
+        if (id.index >= m_timers.size()) { return; }
+
+        Timer& timer = m_timers[id.index];
+        if (timer.generation != id.generation || timer.cancelled) { return; }
+
+        timer.generation++;
+        timer.cancelled = true;
+        m_count--;
+    }
+
+    // steps through every frame up to and including `frame`, calling
+    // onExpire(value) for each timer due on it. onExpire may schedule more timers
+    template <typename F>
+    void advance(int frame, F&& onExpire)
+    {
+        while (m_now < frame)
+        {
+            m_now++;
+
+            // highest level first, what it re-files can land in a lower slot that is also due now
+            int top = 0;
+            while (top < Levels - 1 && (m_now & ((1 << (SlotBits * (top + 1))) - 1)) == 0) { top++; }
+            for (int level = top; level > 0; level--) { cascade(level); }
+
+            // each timer goes back to the pool before its callback, which may schedule into it
+            uint32_t index = take(m_slots[0][m_now & SlotMask]);
+            while (index != None)
+            {
+                Timer& timer = m_timers[index];
+                uint32_t next = timer.next;
+                bool fire = !timer.cancelled;
+                T value = timer.value;
+                if (fire)
+                {
+                    timer.generation++;
+                    m_count--;
+                }
+                release(index);
+
+                if (fire) { onExpire(value); }
+                index = next;
+            }
+        }
+    }
+
+    // drops every timer and restarts the wheel at `frame`. The pool is kept,
+    // and ids from before stay dead
+    void clear(int frame = 0)
+    {
+        m_free = None;
+        for (uint32_t index = 0; index < m_timers.size(); index++)
+        {
+            m_timers[index].generation++;
+            release(index);
+        }
+        for (auto& level : m_slots)
+        {
+            for (auto& slot : level) { slot = Slot(); }
+        }
+        m_now = frame;
+        m_count = 0;
+    }
+};
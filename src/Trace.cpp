@@ -0,0 +1,192 @@
+#include "Trace.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct TraceEvent
+    {
+        const char*     name;
+        uint64_t        timestamp;      // ns since the trace started
+        char            phase;          // 'B'egin or 'E'nd
+    };
+
+    // Single producer (the owning thread), single consumer (the flush thread) ring
+    struct ThreadBuffer
+    {
+        static constexpr uint64_t Capacity = 1 << 16;
+
+        std::array<TraceEvent, Capacity>    events;
+        std::atomic<uint64_t>               head { 0 };     // next slot to write, owned by the producer
+        std::atomic<uint64_t>               tail { 0 };     // next slot to read, owned by the consumer
+        std::atomic<uint64_t>               dropped { 0 };  // events lost because the ring was full
+        uint32_t                            threadId = 0;
+
+        void push(const TraceEvent& e)
+        {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= Capacity)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            events[h % Capacity] = e;
+            head.store(h + 1, std::memory_order_release);
+        }
+    };
+
+    struct TraceState
+    {
+        std::atomic<bool>                           running { false };
+        Clock::time_point                           startTime;
+        std::mutex                                  buffersMutex;       // only taken when a thread registers
+        std::vector<std::unique_ptr<ThreadBuffer>>  buffers;
+        std::ofstream                               file;
+        bool                                        firstEvent = true;
+        std::thread                                 flushThread;
+        std::mutex                                  flushMutex;
+        std::condition_variable                     flushWake;
+        bool                                        stopRequested = false;
+    };
+
+    TraceState& state()
+    {
+        static TraceState s;
+        return s;
+    }
+
+    ThreadBuffer& threadBuffer()
+    {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer)
+        {
+            auto& s = state();
+            std::lock_guard<std::mutex> lock(s.buffersMutex);
+            s.buffers.push_back(std::make_unique<ThreadBuffer>());
+            buffer = s.buffers.back().get();
+            buffer->threadId = (uint32_t)s.buffers.size() - 1;
+        }
+        return *buffer;
+    }
+
+    void record(const char* name, char phase)
+    {
+        auto& s = state();
+        if (!s.running.load(std::memory_order_relaxed)) { return; }
+
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - s.startTime).count();
+        threadBuffer().push({ name, ns, phase });
+    }
+
+    // move every buffered event into the file, only called from one thread at a time
+    void drain()
+    {
+        auto& s = state();
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock(s.buffersMutex);
+            for (auto& b : s.buffers) { buffers.push_back(b.get()); }
+        }
+
+        for (auto* b : buffers)
+        {
+            uint64_t t = b->tail.load(std::memory_order_relaxed);
+            uint64_t h = b->head.load(std::memory_order_acquire);
+            for (; t < h; t++)
+            {
+                const TraceEvent& e = b->events[t % ThreadBuffer::Capacity];
+                s.file << (s.firstEvent ? "\n" : ",\n")
+                       << "{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase
+                       << "\",\"ts\":" << e.timestamp / 1000 << '.' << (e.timestamp % 1000) / 100
+                       << ",\"pid\":1,\"tid\":" << b->threadId << '}';
+                s.firstEvent = false;
+            }
+            b->tail.store(t, std::memory_order_release);
+        }
+    }
+
+    void flushLoop()
+    {
+        auto& s = state();
+        std::unique_lock<std::mutex> lock(s.flushMutex);
+        while (!s.stopRequested)
+        {
+            s.flushWake.wait_for(lock, std::chrono::milliseconds(50));
+            drain();
+        }
+    }
+}
+
+bool Trace::start(const std::string& path)
+{
+    auto& s = state();
+    if (s.running) { return false; }
+
+    s.file.open(path);
+    if (!s.file)
+    {
+        std::cerr << "Could not open trace file " << path << "!\n";
+        return false;
+    }
+
+    s.file << "{\"traceEvents\":[";
+    s.firstEvent = true;
+    s.stopRequested = false;
+    s.startTime = Clock::now();
+    s.running = true;
+    s.flushThread = std::thread(flushLoop);
+    return true;
+}
+
+void Trace::stop()
+{
+    auto& s = state();
+    if (!s.running) { return; }
+
+    s.running = false;
+    {
+        std::lock_guard<std::mutex> lock(s.flushMutex);
+        s.stopRequested = true;
+    }
+    s.flushWake.notify_one();
+    s.flushThread.join();
+
+    // pick up anything pushed between the last drain and running going false
+    drain();
+
+    uint64_t dropped = 0;
+    for (auto& b : s.buffers) { dropped += b->dropped.load(); }
+    s.file << "\n]}\n";
+    s.file.close();
+
+    if (dropped > 0)
+    {
+        std::cerr << "Trace dropped " << dropped << " events, the flush thread fell behind\n";
+    }
+}
+
+bool Trace::running()
+{
+    return state().running;
+}
+
+void Trace::begin(const char* name)
+{
+    record(name, 'B');
+}
+
+void Trace::end(const char* name)
+{
+    record(name, 'E');
+}
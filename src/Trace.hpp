@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Chrome trace / Perfetto instrumentation. Build with GW_ENABLE_TRACE defined
+// to compile the TRACE_SCOPE markers in, otherwise they expand to nothing.
+// Each thread records begin/end events into its own lock-free ring, and a
+// background thread drains the rings into a JSON file that chrome://tracing
+// or ui.perfetto.dev can open
+class Trace
+{
+public:
+
+#ifdef GW_ENABLE_TRACE
+    static constexpr bool CompiledIn = true;
+#else
+    static constexpr bool CompiledIn = false;
+#endif
+
+    static bool start(const std::string& path);     // open the file and start the flush thread
+    static void stop();                             // flush everything left and close the file
+    static bool running();
+
+    // name must outlive the trace, in practice a string literal
+    static void begin(const char* name);
+    static void end(const char* name);
+};
+
+// Records a begin event on construction and the matching end event on destruction
+class TraceScope
+{
+    const char* m_name;
+
+public:
+
+    TraceScope(const char* name)
+        : m_name(name)
+    {
+        Trace::begin(m_name);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator = (const TraceScope&) = delete;
+
+    ~TraceScope()
+    {
+        Trace::end(m_name);
+    }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef GW_ENABLE_TRACE
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
-#include <math.h>
+#include <cmath>
 
 template <typename T>
 class Vec2
@@ -11,9 +11,9 @@ public:
     T x = 0;
     T y = 0;
 
-    Vec2() = default;
+    constexpr Vec2() = default;
 
-    Vec2(T xin, T yin)
+    constexpr Vec2(T xin, T yin)
         : x(xin), y(yin)
     {}
 
@@ -24,75 +24,121 @@ public:
 
     // allow automatic conversion to sf::Vector2
     // this lets us pass Vec2 into sfml functions
-    operator sf::Vector2<T>()
+    operator sf::Vector2<T>() const
     {
         return sf::Vector2<T>(x, y);
     }
 
-    Vec2 operator + (const Vec2& rhs) const
+    // unit vector at an angle in radians, scaled to length
+    static Vec2 polar(T angle, T length = 1)
+    {
+        return Vec2(std::cos(angle) * length, std::sin(angle) * length);
+    }
+
+    constexpr Vec2 operator + (const Vec2& rhs) const
     {
-        
         return Vec2(x + rhs.x, y + rhs.y);
     }
 
-    Vec2 operator - (const Vec2& rhs) const
+    constexpr Vec2 operator - (const Vec2& rhs) const
     {
         return Vec2(x - rhs.x, y - rhs.y);
     }
 
-    Vec2 operator / (const T val) const
+    constexpr Vec2 operator - () const
+    {
+        return Vec2(-x, -y);
+    }
+
+    constexpr Vec2 operator / (const T val) const
     {
         return Vec2(x / val, y / val);
     }
 
-    Vec2 operator * (const T val) const
+    constexpr Vec2 operator * (const T val) const
     {
         return Vec2(x * val, y * val);
     }
 
-    bool operator == (const Vec2& rhs) const
+    constexpr bool operator == (const Vec2& rhs) const
     {
         return (x == rhs.x && y == rhs.y);
     }
 
-    bool operator != (const Vec2& rhs) const
+    constexpr bool operator != (const Vec2& rhs) const
     {
         return (x != rhs.x || y != rhs.y);
     }
 
-    void operator += (const Vec2& rhs)
+    constexpr void operator += (const Vec2& rhs)
     {
         x += rhs.x;
         y += rhs.y;
     }
 
-    void operator -= (const Vec2& rhs)
+    constexpr void operator -= (const Vec2& rhs)
     {
         x -= rhs.x;
         y -= rhs.y;
     }
 
-    void operator *= (const T val)
+    constexpr void operator *= (const T val)
     {
         x *= val;
         y *= val;
     }
 
-    void operator /= (const T val)
+    constexpr void operator /= (const T val)
     {
         x /= val;
         y /= val;
     }
 
-    float dist(const Vec2& rhs) const
+    constexpr T dot(const Vec2& rhs) const
+    {
+        return x * rhs.x + y * rhs.y;
+    }
+
+    constexpr T lengthSquared() const
+    {
+        return x * x + y * y;
+    }
+
+    // cheaper than dist() when only comparing distances, compare against a squared radius
+    constexpr T distSquared(const Vec2& rhs) const
+    {
+        return (*this - rhs).lengthSquared();
+    }
+
+    T dist(const Vec2& rhs) const
+    {
+        return std::sqrt(distSquared(rhs));
+    }
+
+    T length() const
+    {
+        return std::sqrt(lengthSquared());
+    }
+
+    // unit vector in the same direction, the zero vector stays zero
+    Vec2 normalized() const
+    {
+        T len = length();
+        return len > 0 ? *this / len : Vec2();
+    }
+
+    void normalize()
     {
-        return std::sqrtf((x-rhs.x)*(x-rhs.x) + (y-rhs.y)*(y-rhs.y));
+        *this = normalized();
     }
 
-    float length() const
+    // rotated counter clockwise by an angle in radians (clockwise on screen, y points down)
+    Vec2 rotated(T angle) const
     {
-        return std::sqrtf((x * x) + (y * y));
+        T c = std::cos(angle);
+        T s = std::sin(angle);
+        return Vec2(x * c - y * s, x * s + y * c);
     }
 };
 
-using Vec2f = Vec2<float>;
\ No newline at end of file
+using Vec2f = Vec2<float>;
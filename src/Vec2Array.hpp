@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Vec2.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// A batch of Vec2 stored as one array of x and one array of y. Each batch
+// operation is a flat loop over the two arrays with no dependency between
+// elements, which the compiler turns into SIMD code at -O2 / /O2
+template <typename T>
+class Vec2Array
+{
+    std::vector<T>  m_x;
+    std::vector<T>  m_y;
+
+public:
+
+    Vec2Array() = default;
+
+    Vec2Array(const std::vector<Vec2<T>>& points)
+    {
+        for (auto& p : points) { push_back(p); }
+    }
+
+    size_t size() const
+    {
+        return m_x.size();
+    }
+
+    bool empty() const
+    {
+        return m_x.empty();
+    }
+
+    void clear()
+    {
+        m_x.clear();
+        m_y.clear();
+    }
+
+    void resize(size_t size)
+    {
+        m_x.resize(size);
+        m_y.resize(size);
+    }
+
+    void reserve(size_t size)
+    {
+        m_x.reserve(size);
+        m_y.reserve(size);
+    }
+
+    void push_back(const Vec2<T>& v)
+    {
+        m_x.push_back(v.x);
+        m_y.push_back(v.y);
+    }
+
+    Vec2<T> operator [] (size_t i) const
+    {
+        return Vec2<T>(m_x[i], m_y[i]);
+    }
+
+    void set(size_t i, const Vec2<T>& v)
+    {
+        m_x[i] = v.x;
+        m_y[i] = v.y;
+    }
+
+    T* x()              { return m_x.data(); }
+    T* y()              { return m_y.data(); }
+    const T* x() const  { return m_x.data(); }
+    const T* y() const  { return m_y.data(); }
+
+    // every element set to v, the size is unchanged
+    void fill(const Vec2<T>& v)
+    {
+        std::fill(m_x.begin(), m_x.end(), v.x);
+        std::fill(m_y.begin(), m_y.end(), v.y);
+    }
+
+    // this[i] += other[i] * scale, other must be at least as long
+    void addScaled(const Vec2Array& other, T scale)
+    {
+        T* x = m_x.data();
+        T* y = m_y.data();
+        const T* ox = other.x();
+        const T* oy = other.y();
+        for (size_t i = 0; i < size(); i++)
+        {
+            x[i] += ox[i] * scale;
+            y[i] += oy[i] * scale;
+        }
+    }
+
+    // out[i] = squared distance from element i to point, out must hold size() values
+    void distSquared(const Vec2<T>& point, T* out) const
+    {
+        const T* x = m_x.data();
+        const T* y = m_y.data();
+        for (size_t i = 0; i < size(); i++)
+        {
+            T dx = x[i] - point.x;
+            T dy = y[i] - point.y;
+            out[i] = dx * dx + dy * dy;
+        }
+    }
+
+    // every element scaled to length 1, zero vectors stay zero
+    void normalizeAll()
+    {
+        T* x = m_x.data();
+        T* y = m_y.data();
+        for (size_t i = 0; i < size(); i++)
+        {
+            T len = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+            T inv = len > 0 ? T(1) / len : T(0);
+            x[i] *= inv;
+            y[i] *= inv;
+        }
+    }
+
+    // every element rotated by the same angle in radians, see Vec2::rotated
+    void rotateAll(T angle)
+    {
+        T c = std::cos(angle);
+        T s = std::sin(angle);
+        T* x = m_x.data();
+        T* y = m_y.data();
+        for (size_t i = 0; i < size(); i++)
+        {
+            T rx = x[i] * c - y[i] * s;
+            T ry = x[i] * s + y[i] * c;
+            x[i] = rx;
+            y[i] = ry;
+        }
+    }
+};
+
+using Vec2fArray = Vec2Array<float>;
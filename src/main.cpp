@@ -2,9 +2,58 @@
 
 #include "Game.h"
 #include <iostream>
+#include <string>
 
-int main()
+void printUsage(const char* program)
 {
-    Game g("config.txt");
+    std::cerr << "usage: " << program << " [options]\n"
+              << "  --config <path>     config file to load (default config.txt)\n"
+              << "  --headless          run the simulation without a window, ImGui or fonts\n"
+              << "  --seed <n>          seed the random number generator\n"
+              << "  --frames <n>        quit after n frames\n"
+              << "  --input <path>      replay scripted input from a file\n"
+              << "  --threads <n>       simulation threads including the main one (default: every core)\n"
+              << "  --trace <path>      write a Chrome trace JSON file (needs a GW_ENABLE_TRACE build)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    GameOptions options;
+    std::string tracePath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--config" && hasValue) { options.config = argv[++i]; }
+        else if (arg == "--headless") { options.headless = true; }
+        else if (arg == "--seed" && hasValue) { options.seed = (unsigned)std::stoul(argv[++i]); }
+        else if (arg == "--frames" && hasValue) { options.frames = std::stoi(argv[++i]); }
+        else if (arg == "--input" && hasValue) { options.inputScript = argv[++i]; }
+        else if (arg == "--threads" && hasValue) { options.threads = (unsigned)std::stoul(argv[++i]); }
+        else if (arg == "--trace" && hasValue) { tracePath = argv[++i]; }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!tracePath.empty())
+    {
+        if (!Trace::CompiledIn)
+        {
+            std::cerr << "--trace ignored, this build was made without GW_ENABLE_TRACE\n";
+        }
+        else
+        {
+            Trace::start(tracePath);
+        }
+    }
+
+    Game g(options);
     g.run();
-}
\ No newline at end of file
+
+    Trace::stop();
+}
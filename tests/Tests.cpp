@@ -0,0 +1,413 @@
+#include "Game.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Checks for the parts of the game that are easy to break without anything
+// looking wrong on screen. Every test runs, each failed check is reported
+// with its line, and the exit code is the number of failures. Run it from
+// the repository root (ctest does), the game tests load config.txt and their
+// input scripts from there
+class Tests
+{
+    int m_failures = 0;
+
+    void check(bool ok, const char* what, int line)
+    {
+        if (ok) { return; }
+        std::cerr << "tests/Tests.cpp:" << line << ": check failed: " << what << "\n";
+        m_failures++;
+    }
+
+public:
+
+    // once the first second has filled the pools and sized the arrays, a
+    // seeded game playing a script must not touch the heap on any thread
+    // count. The play area is 6x6 windows holding 1500 extra enemies, as
+    // crowded as a normal game but over Game::ParallelEntities the whole way,
+    // so with several threads every tick goes through the scheduler, the job
+    // system, the per-thread command buffers and the chunked contact lists
+    void steadyStateAllocations()
+    {
+        for (unsigned threads : { 1u, 4u })
+        {
+            GameOptions options;
+            options.headless = true;
+            options.seed = 7;
+            options.frames = 3000;
+            options.threads = threads;
+            options.inputScript = "tests/steady_state.txt";
+
+            Game g(options);
+            g.m_windowSize = sf::Vector2u(g.m_windowSize.x * 6, g.m_windowSize.y * 6);
+            g.m_xDist = std::uniform_real_distribution<float>(g.m_enemyConfig.SR, g.m_windowSize.x - g.m_enemyConfig.SR);
+            g.m_yDist = std::uniform_real_distribution<float>(g.m_enemyConfig.SR, g.m_windowSize.y - g.m_enemyConfig.SR);
+            for (int i = 0; i < 1500; i++) { g.spawnEnemy(); }
+
+            g.run();
+            check(g.m_entities.getEntities().size() >= Game::ParallelEntities, "scene stayed on the parallel path", __LINE__);
+            check(g.m_steadyAllocations == 0, "steady state allocations == 0", __LINE__);
+        }
+    }
+
+    // timers scheduled and cancelled at random, from already due to far past
+    // the lowest level's 64 frames, fire on the same frames as a multimap of
+    // (due, id) says they should, and cancelled ones never fire
+    void timerWheel()
+    {
+        std::mt19937 rng(11);
+        TimerWheel<int> wheel;
+        std::multimap<int, int> expected;                       // due frame -> id, what is still pending
+        std::vector<std::pair<TimerWheel<int>::Id, int>> ids;   // every id handed out, with its due frame
+        int now = 0;
+
+        for (int step = 0; step < 20000; step++)
+        {
+            for (int n = rng() % 4; n > 0; n--)
+            {
+                static const int spans[] = { 64, 4096, 1 << 18, 1 << 25 };
+                int delay = (int)(rng() % spans[rng() % 4]) - 2;
+                int due = std::max(now + delay, now + 1);
+                ids.push_back({ wheel.schedule(now + delay, (int)ids.size()), due });
+                expected.insert({ due, (int)ids.size() - 1 });
+            }
+
+            // cancel some, including ones that already fired or were cancelled
+            for (int n = rng() % 3; n > 0 && !ids.empty(); n--)
+            {
+                int id = (int)(rng() % ids.size());
+                wheel.cancel(ids[id].first);
+                auto range = expected.equal_range(ids[id].second);
+                for (auto it = range.first; it != range.second; ++it)
+                {
+                    if (it->second == id) { expected.erase(it); break; }
+                }
+            }
+
+            int to = now + (rng() % 50 == 0 ? (int)(rng() % 5000) : (int)(rng() % 3));
+            std::vector<std::pair<int, int>> fired;
+            wheel.advance(to, [&](int id) { fired.push_back({ ids[id].second, id }); });
+            now = to;
+
+            // fired in due order, and exactly what the reference has due by now
+            bool ordered = std::is_sorted(fired.begin(), fired.end(),
+                [](auto& a, auto& b) { return a.first < b.first; });
+            std::vector<std::pair<int, int>> due(expected.begin(), expected.upper_bound(now));
+            expected.erase(expected.begin(), expected.upper_bound(now));
+            std::sort(fired.begin(), fired.end());
+            std::sort(due.begin(), due.end());
+
+            check(ordered, "timers fire in due order", __LINE__);
+            check(fired == due, "fired timers == reference", __LINE__);
+            check(wheel.size() == expected.size(), "pending timers == reference", __LINE__);
+            if (m_failures) { return; }
+        }
+    }
+
+    // every instruction set this CPU has gives exactly the scalar results on
+    // the same random arrays, for ranges that start unaligned and end in a
+    // tail shorter than a vector
+    void kernels()
+    {
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> spread(-50.0f, 850.0f);
+        const TagId tag = 2;
+        const Kernels::Isa previous = Kernels::current();
+
+        for (size_t count : { 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 1001 })
+        {
+            for (size_t begin : { 0, 1, 3 })
+            {
+                size_t size = begin + count + 2;                // a slot either side of the range must not change
+                std::vector<Vec2f> positions(size), velocities(size);
+                std::vector<float> angles(size);
+                std::vector<TagId> tags(size);
+                for (size_t i = 0; i < size; i++)
+                {
+                    positions[i] = Vec2f(spread(rng), spread(rng));
+                    velocities[i] = Vec2f(spread(rng), spread(rng)) * 0.01f;
+                    angles[i] = spread(rng);
+                    tags[i] = (TagId)(rng() % 3 + 1);
+                }
+
+                std::vector<Vec2f> scalarPositions, scalarVelocities;
+                std::vector<float> scalarAngles;
+                for (int isa = (int)Kernels::Isa::Scalar; isa <= (int)Kernels::best(); isa++)
+                {
+                    Kernels::use((Kernels::Isa)isa);
+                    check(Kernels::current() == (Kernels::Isa)isa, "kernels switched instruction set", __LINE__);
+
+                    auto p = positions, v = velocities;
+                    auto a = angles;
+                    Kernels::integrate(p.data(), v.data(), a.data(), begin, begin + count, 1.5f);
+                    Kernels::bounce(p.data(), v.data(), tags.data(), tag, 20.0f, 800.0f, 600.0f, begin, begin + count);
+
+                    if (isa == (int)Kernels::Isa::Scalar)
+                    {
+                        scalarPositions = p;
+                        scalarVelocities = v;
+                        scalarAngles = a;
+                        check(p[begin + count] == positions[begin + count] && a[begin + count] == angles[begin + count],
+                            "slot past the range untouched", __LINE__);
+                        continue;
+                    }
+
+                    std::string what = std::string(Kernels::name((Kernels::Isa)isa)) + " == scalar, "
+                        + std::to_string(count) + " slots from " + std::to_string(begin);
+                    check(p == scalarPositions && v == scalarVelocities && a == scalarAngles, what.c_str(), __LINE__);
+                }
+            }
+        }
+        Kernels::use(previous);
+    }
+
+    // a bullet that jumps clean over an enemy in one tick, so neither end of
+    // its move overlaps it, still hits it, and only because it is swept
+    void sweptBullet()
+    {
+        GameOptions options;
+        options.headless = true;
+        options.seed = 7;
+        options.threads = 1;
+
+        Game g(options);
+        g.spawnPlayer();
+        g.spawnEnemy();
+        g.m_entities.update();
+
+        // player, enemy and the bullet's path on one line, the enemy 200 px from the player
+        Entity player = g.player();
+        Entity enemy = g.m_entities.getEntities(Tag::Enemy).front();
+        player.get<CTransform>().pos = Vec2f(100.0f, 300.0f);
+        enemy.get<CTransform>().pos = Vec2f(300.0f, 300.0f);
+        enemy.get<CTransform>().velocity = Vec2f(0.0f, 0.0f);
+        g.spawnBullet(player, enemy.get<CTransform>().pos);
+        g.m_entities.update();
+        Entity bullet = g.m_entities.getEntities(Tag::Bullet).front();
+
+        // one tick carries it from 200 px before the enemy to 50 px past it,
+        // further than the two radii put together
+        auto& transforms = g.m_entities.getComponents<CTransform>();
+        transforms.storePrevious();
+        bullet.get<CTransform>().pos = Vec2f(350.0f, 300.0f);
+        float reach = enemy.get<CCollision>().radius + bullet.get<CCollision>().radius;
+        check(reach < 50.0f, "bullet ends clear of the enemy", __LINE__);
+
+        auto hits = [&]()
+        {
+            g.sCollision();
+            for (auto& contact : g.m_contacts)
+            {
+                if (contact.a.handle() == enemy.handle() && contact.b.handle() == bullet.handle() && contact.kind == ContactKind::EnemyShot) { return true; }
+            }
+            return false;
+        };
+
+        check(bullet.get<CCollision>().swept, "bullets are swept", __LINE__);
+        check(hits(), "swept bullet hits the enemy it passed through", __LINE__);
+
+        bullet.get<CCollision>().swept = false;
+        check(!hits(), "unswept bullet tunnels through the enemy", __LINE__);
+    }
+
+    // the Vec2Array batch kernels agree with the same Vec2 operation done one
+    // element at a time, zero vectors included
+    void vec2Array()
+    {
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> spread(-500.0f, 500.0f);
+        auto near = [](const Vec2f& a, const Vec2f& b)
+        {
+            return std::abs(a.x - b.x) <= 1e-4f * (1.0f + std::abs(b.x)) && std::abs(a.y - b.y) <= 1e-4f * (1.0f + std::abs(b.y));
+        };
+
+        for (size_t count : { 0, 1, 7, 64, 1001 })
+        {
+            std::vector<Vec2f> a(count), b(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                a[i] = i % 13 == 5 ? Vec2f() : Vec2f(spread(rng), spread(rng));
+                b[i] = Vec2f(spread(rng), spread(rng));
+            }
+            Vec2f point(spread(rng), spread(rng));
+
+            Vec2fArray scaled(a), normalized(a), rotated(a);
+            scaled.addScaled(Vec2fArray(b), 0.25f);
+            normalized.normalizeAll();
+            rotated.rotateAll(0.7f);
+            std::vector<float> distances(count);
+            Vec2fArray(a).distSquared(point, distances.data());
+
+            bool ok = scaled.size() == count;
+            for (size_t i = 0; i < count; i++)
+            {
+                ok = ok && near(scaled[i], a[i] + b[i] * 0.25f)
+                    && near(normalized[i], a[i].normalized())
+                    && near(rotated[i], a[i].rotated(0.7f))
+                    && std::abs(distances[i] - a[i].distSquared(point)) <= 1e-4f * (1.0f + a[i].distSquared(point));
+            }
+            check(ok, ("Vec2Array kernels == Vec2, " + std::to_string(count) + " elements").c_str(), __LINE__);
+        }
+    }
+
+    // radius, box and k-nearest lookups, each narrowed to some tags, find
+    // exactly what scanning every live entity with those tags finds. The scene
+    // has dead entities and a tag the index doesn't hold, and spreads past the
+    // window so lookups also land on empty and far away cells
+    void spatialIndex()
+    {
+        std::mt19937 rng(9);
+        std::uniform_real_distribution<float> spread(-300.0f, 2300.0f);
+        EntityManager entities;
+        for (int i = 0; i < 2000; i++)
+        {
+            static const TagId tags[] = { Tag::Enemy, Tag::SmallEnemy, Tag::Bullet };
+            Entity e = entities.addEntity(tags[rng() % 3]);
+            e.add<CTransform>(Vec2f(spread(rng), spread(rng)), Vec2f(), 0.0f);
+        }
+        entities.update();
+        for (auto& e : entities.getEntities())
+        {
+            if (rng() % 10 == 0) { e.destroy(); }
+        }
+
+        SpatialIndex index({ Tag::Enemy, Tag::SmallEnemy }, 64.0f);
+        index.refresh(entities, 0);
+
+        // every live entity with one of the tags that the index holds, by id
+        auto scan = [&](std::initializer_list<TagId> tags, auto&& inside)
+        {
+            std::vector<size_t> ids;
+            for (TagId tag : tags)
+            {
+                if (tag != Tag::Enemy && tag != Tag::SmallEnemy) { continue; }
+                for (auto& e : entities.getEntities(tag))
+                {
+                    if (e.isActive() && inside(e.get<CTransform>().pos)) { ids.push_back(e.id()); }
+                }
+            }
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        auto sorted = [](std::vector<size_t> ids) { std::sort(ids.begin(), ids.end()); return ids; };
+
+        const std::initializer_list<TagId> filters[] =
+            { { Tag::Enemy }, { Tag::SmallEnemy }, { Tag::Enemy, Tag::SmallEnemy }, { Tag::Bullet }, { Tag::Bullet, Tag::SmallEnemy } };
+        std::vector<Entity> nearest;
+        for (int q = 0; q < 300; q++)
+        {
+            auto& tags = filters[q % 5];
+            Vec2f pos(spread(rng), spread(rng));
+            float radius = (float)(rng() % 400);
+
+            std::vector<size_t> found;
+            index.queryRadius(pos, radius, tags, [&](const Entity& e) { found.push_back(e.id()); });
+            check(sorted(found) == scan(tags, [&](const Vec2f& p) { return p.distSquared(pos) < radius * radius; }),
+                "queryRadius == scan", __LINE__);
+
+            Vec2f min = pos - Vec2f(radius, radius * 0.5f), max = pos + Vec2f(radius * 0.5f, radius);
+            found.clear();
+            index.queryAABB(min, max, tags, [&](const Entity& e) { found.push_back(e.id()); });
+            check(sorted(found) == scan(tags, [&](const Vec2f& p) { return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y; }),
+                "queryAABB == scan", __LINE__);
+
+            // nearest first, and as near as the k nearest of the scan (ties may come in either order)
+            size_t k = 1 + rng() % 8;
+            index.kNearest(pos, k, tags, nearest);
+            std::vector<float> distances, expected;
+            for (auto& e : nearest) { distances.push_back(e.get<CTransform>().pos.distSquared(pos)); }
+            for (size_t id : scan(tags, [](const Vec2f&) { return true; }))
+            {
+                expected.push_back(entities.getComponents<CTransform>().positions()[id].distSquared(pos));
+            }
+            std::sort(expected.begin(), expected.end());
+            expected.resize(std::min(k, expected.size()));
+            check(distances == expected, "kNearest == scan", __LINE__);
+            if (m_failures) { return; }
+        }
+    }
+
+    // threads destroying the same entities at the same time still record
+    // each slot once, so update() removes every one
+    // of them exactly once and hands back every slot
+    void concurrentDestroy()
+    {
+        JobSystem jobs(4);
+        EntityManager entities;
+        for (int i = 0; i < 5000; i++) { entities.addEntity(Tag::Bullet); }
+        entities.update();
+
+        // every job walks all of them, half of them from the far end
+        const auto& bullets = entities.getEntities(Tag::Bullet);
+        jobs.parallelFor(8, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t job = begin; job < end; job++)
+            {
+                for (size_t i = 0; i < bullets.size(); i++) { bullets[job % 2 ? bullets.size() - 1 - i : i].destroy(); }
+            }
+        });
+        entities.update();
+
+        check(entities.getEntities().empty() && bullets.empty(), "every destroyed entity removed", __LINE__);
+        size_t reused = 0;
+        for (int i = 0; i < 5000; i++) { reused += entities.addEntity(Tag::Bullet).id() < 5000; }
+        entities.update();
+        check(reused == 5000 && entities.getEntities().size() == 5000, "every slot handed back once", __LINE__);
+    }
+
+    // a special fired by a live player spawns its allies, one fired by a
+    // player that died last tick spawns nothing for the respawned one to inherit
+    void specialAfterDeath()
+    {
+        GameOptions options;
+        options.headless = true;
+        options.seed = 7;
+        options.threads = 1;
+
+        Game g(options);
+        g.m_spawning = false;
+        g.tick();
+        size_t vertices = g.player().get<CShape>().points;
+
+        g.spawnSpecialWeapon(g.player());
+        g.tick();
+        check(g.m_entities.getEntities(Tag::SmallAlly).size() == vertices, "live player's special spawns its allies", __LINE__);
+
+        // what sCollisionResponse does when an enemy reaches the player
+        g.player().destroy();
+        for (auto& s : g.m_entities.getEntities(Tag::SmallAlly)) { s.destroy(); }
+        g.m_entities.resource<CSpecial>().available = true;
+
+        g.spawnSpecialWeapon(g.player());
+        g.tick();
+        check(g.player().isActive(), "player respawned", __LINE__);
+        check(g.m_entities.getEntities(Tag::SmallAlly).empty(), "dead player's special spawns nothing", __LINE__);
+    }
+
+    int run()
+    {
+        steadyStateAllocations();
+        timerWheel();
+        kernels();
+        vec2Array();
+        spatialIndex();
+        concurrentDestroy();
+        sweptBullet();
+        specialAfterDeath();
+        return m_failures;
+    }
+};
+
+int main()
+{
+    Tests tests;
+    int failures = tests.run();
+    std::cout << (failures ? "FAILED" : "passed") << " (" << failures << " failed checks)\n";
+    return failures;
+}